@@ -0,0 +1,173 @@
+#include <string.h>
+#include "backlog_segment.h"
+
+static void read_header(const uint8_t *segment, segment_header *header) {
+  memcpy(header, segment, sizeof(*header));
+}
+
+static void write_header(uint8_t *segment, segment_header *header) {
+  memcpy(segment, header, sizeof(*header));
+}
+
+// Bits are stored most significant first, starting after the header.
+static void put_bits(uint8_t *segment, uint16_t *bit, uint32_t value, uint8_t count) {
+  uint8_t *data = segment + SEGMENT_HEADER_SIZE;
+
+  while (count > 0) {
+    count--;
+    uint8_t mask = 0x80 >> (*bit % 8);
+
+    if ((value >> count) & 1) {
+      data[*bit / 8] |= mask;
+    } else {
+      data[*bit / 8] &= ~mask;
+    }
+    (*bit)++;
+  }
+}
+
+static uint32_t get_bits(const uint8_t *segment, uint16_t *bit, uint8_t count) {
+  const uint8_t *data = segment + SEGMENT_HEADER_SIZE;
+  uint32_t value = 0;
+
+  while (count > 0) {
+    count--;
+    value = (value << 1) | ((data[*bit / 8] >> (7 - *bit % 8)) & 1);
+    (*bit)++;
+  }
+
+  return value;
+}
+
+static int32_t get_signed(const uint8_t *segment, uint16_t *bit, uint8_t count) {
+  uint32_t value = get_bits(segment, bit, count);
+
+  if (count < 32 && (value & (1UL << (count - 1)))) value |= ~0UL << count;
+  return (int32_t) value;
+}
+
+static bool fits(int32_t value, uint8_t count) {
+  return value >= -(1L << (count - 1)) && value < (1L << (count - 1));
+}
+
+// Timestamp delta of deltas: '0' for none, then 7, 9 or 12 bits behind
+// '10', '110' and '1110', and the full 32 bits behind '1111'.
+static void put_time(uint8_t *segment, uint16_t *bit, int32_t value) {
+  if (value == 0) {
+    put_bits(segment, bit, 0x0, 1);
+  } else if (fits(value, 7)) {
+    put_bits(segment, bit, 0x2, 2); put_bits(segment, bit, value, 7);
+  } else if (fits(value, 9)) {
+    put_bits(segment, bit, 0x6, 3); put_bits(segment, bit, value, 9);
+  } else if (fits(value, 12)) {
+    put_bits(segment, bit, 0xe, 4); put_bits(segment, bit, value, 12);
+  } else {
+    put_bits(segment, bit, 0xf, 4); put_bits(segment, bit, value, 32);
+  }
+}
+
+static int32_t get_time(const uint8_t *segment, uint16_t *bit) {
+  if (get_bits(segment, bit, 1) == 0) return 0;
+  if (get_bits(segment, bit, 1) == 0) return get_signed(segment, bit, 7);
+  if (get_bits(segment, bit, 1) == 0) return get_signed(segment, bit, 9);
+  if (get_bits(segment, bit, 1) == 0) return get_signed(segment, bit, 12);
+  return get_signed(segment, bit, 32);
+}
+
+// Value deltas: '0' for none, then 6 or 10 bits behind '10' and '110',
+// and 17 bits, enough for any change of a 16 bit field, behind '111'.
+static void put_value(uint8_t *segment, uint16_t *bit, int32_t value) {
+  if (value == 0) {
+    put_bits(segment, bit, 0x0, 1);
+  } else if (fits(value, 6)) {
+    put_bits(segment, bit, 0x2, 2); put_bits(segment, bit, value, 6);
+  } else if (fits(value, 10)) {
+    put_bits(segment, bit, 0x6, 3); put_bits(segment, bit, value, 10);
+  } else {
+    put_bits(segment, bit, 0x7, 3); put_bits(segment, bit, value, 17);
+  }
+}
+
+static int32_t get_value(const uint8_t *segment, uint16_t *bit) {
+  if (get_bits(segment, bit, 1) == 0) return 0;
+  if (get_bits(segment, bit, 1) == 0) return get_signed(segment, bit, 6);
+  if (get_bits(segment, bit, 1) == 0) return get_signed(segment, bit, 10);
+  return get_signed(segment, bit, 17);
+}
+
+void segment_clear(uint8_t *segment, segment_cursor *cursor) {
+  memset(segment, 0, SEGMENT_SIZE);
+  segment_rewind(cursor);
+}
+
+void segment_rewind(segment_cursor *cursor) {
+  memset(cursor, 0, sizeof(*cursor));
+}
+
+uint16_t segment_count(const uint8_t *segment) {
+  segment_header header;
+  read_header(segment, &header);
+  return header.count;
+}
+
+// cursor must be at the end of the segment.  Returns false, leaving the
+// segment as it was, if the segment is full.
+bool segment_append(uint8_t *segment, segment_cursor *cursor, uint32_t time, int16_t temperature_f, uint16_t humidity) {
+  segment_header header;
+  read_header(segment, &header);
+
+  if (header.count == 0) {
+    header.first_time = time;
+    header.first_temperature_f = temperature_f;
+    header.first_humidity = humidity;
+    cursor->delta = 0;
+  } else {
+    if (cursor->bit + SEGMENT_MAX_READING_BITS > SEGMENT_DATA_BITS) return false;
+
+    int32_t delta = time - cursor->time;
+    put_time(segment, &cursor->bit, delta - cursor->delta);
+    put_value(segment, &cursor->bit, (int32_t) temperature_f - cursor->temperature_f);
+    put_value(segment, &cursor->bit, (int32_t) humidity - cursor->humidity);
+    cursor->delta = delta;
+  }
+
+  cursor->time = time;
+  cursor->temperature_f = temperature_f;
+  cursor->humidity = humidity;
+  cursor->index++;
+
+  header.count = cursor->index;
+  header.bits = cursor->bit;
+  write_header(segment, &header);
+
+  return true;
+}
+
+// Decode the reading at cursor and step past it.  Returns false at the end
+// of the segment.
+bool segment_next(const uint8_t *segment, segment_cursor *cursor, uint32_t *time, int16_t *temperature_f, uint16_t *humidity) {
+  segment_header header;
+  read_header(segment, &header);
+
+  if (cursor->index >= header.count) return false;
+  if (cursor->bit > SEGMENT_DATA_BITS - SEGMENT_MAX_READING_BITS) return false;  // corrupt count
+
+  if (cursor->index == 0) {
+    cursor->time = header.first_time;
+    cursor->delta = 0;
+    cursor->temperature_f = header.first_temperature_f;
+    cursor->humidity = header.first_humidity;
+  } else {
+    cursor->delta += get_time(segment, &cursor->bit);
+    cursor->time += cursor->delta;
+    cursor->temperature_f += get_value(segment, &cursor->bit);
+    cursor->humidity += get_value(segment, &cursor->bit);
+  }
+
+  cursor->index++;
+
+  *time = cursor->time;
+  *temperature_f = cursor->temperature_f;
+  *humidity = cursor->humidity;
+  return true;
+}
@@ -0,0 +1,43 @@
+#ifndef BACKLOG_SEGMENT_H
+#define BACKLOG_SEGMENT_H
+
+// Plain C++ with no Arduino dependencies, so tools/ can build it on Linux.
+#include <stdint.h>
+
+#define SEGMENT_SIZE         512
+#define SEGMENT_HEADER_SIZE  12
+#define SEGMENT_DATA_BITS    ((SEGMENT_SIZE - SEGMENT_HEADER_SIZE) * 8)
+#define SEGMENT_MAX_READING_BITS  76  // worst case for one reading after the first
+
+// A segment is one sector of compressed readings, in the style of
+// Facebook's Gorilla: the first reading is stored whole in the header,
+// and each later one as the delta of its timestamp delta and the deltas
+// of its fixed point temperature and humidity, each behind a short prefix
+// code that picks the field width.  Readings taken a steady interval
+// apart with slowly changing values cost a few bits each.
+typedef struct {
+  uint16_t count;
+  uint16_t bits;  // used bits after the header
+  uint32_t first_time;
+  int16_t first_temperature_f;  // hundredths, as in packed_reading
+  uint16_t first_humidity;
+} segment_header;
+
+// Position in a segment and the last reading at that position.  Decoding
+// a segment to its end leaves the cursor ready to append to it.
+typedef struct {
+  uint16_t index;
+  uint16_t bit;
+  uint32_t time;
+  int32_t delta;
+  int16_t temperature_f;
+  uint16_t humidity;
+} segment_cursor;
+
+void segment_clear(uint8_t *segment, segment_cursor *cursor);
+void segment_rewind(segment_cursor *cursor);
+uint16_t segment_count(const uint8_t *segment);
+bool segment_append(uint8_t *segment, segment_cursor *cursor, uint32_t time, int16_t temperature_f, uint16_t humidity);
+bool segment_next(const uint8_t *segment, segment_cursor *cursor, uint32_t *time, int16_t *temperature_f, uint16_t *humidity);
+
+#endif
@@ -1,10 +1,14 @@
 #include <Arduino.h>
+#include <stddef.h>
 #include <DHT.h>
 #include "config.h"
 #include <SD.h>
 #include "watchdog.h"
 #include "rtc.h"
 #include "transmit.h"
+#include "retained.h"
+#include "data_log.h"
+#include "summary.h"
 
 #ifdef HEATSEEK_FEATHER_WIFI_WICED
 char const* get_encryption_str(int32_t enc_type);
@@ -13,6 +17,42 @@ char const* get_encryption_str(int32_t enc_type);
 CONFIG_union CONFIG;
 static DHT dht(DHT_DATA, DHT22);
 
+// New fields are only ever appended to CONFIG_struct, so a config written
+// by older firmware is a prefix of the current one.  Returns how many bytes
+// a config file of the given version must contain, or 0 if it can't be
+// upgraded.
+int config_size_for_version(uint16_t version) {
+  switch (version) {
+    case 6: return offsetof(CONFIG_struct, batch_size);
+    case 7: return offsetof(CONFIG_struct, dns_ttl_s);
+    case 8: return offsetof(CONFIG_struct, fona_baud);
+    case 9: return offsetof(CONFIG_struct, compact_depth);
+    case CONFIG_VERSION: return sizeof(CONFIG_struct);
+    default: return 0;
+  }
+}
+
+// Fill in defaults for the fields an older config doesn't have.
+void upgrade_config(uint16_t from_version) {
+  if (from_version < 7) {
+    CONFIG.data.batch_size = 1;
+  }
+
+  if (from_version < 8) {
+    CONFIG.data.dns_ttl_s = DEFAULT_DNS_TTL_S;
+  }
+
+  if (from_version < 9) {
+    CONFIG.data.fona_baud = 0;
+  }
+
+  if (from_version < 10) {
+    CONFIG.data.compact_depth = DEFAULT_COMPACT_DEPTH;
+  }
+
+  CONFIG.data.version = CONFIG_VERSION;
+}
+
 void write_config() {
   File config_file;
   
@@ -28,29 +68,36 @@ void write_config() {
 bool read_config() {
   File config_file;
   bool success = false;
+  bool upgraded = false;
 
   if (config_file = SD.open("config.bin", FILE_READ)) {
     int read_size = config_file.read(CONFIG.raw, sizeof(CONFIG));
+    int expected_size = config_size_for_version(CONFIG.data.version);
     
-    if (sizeof(CONFIG) == read_size) {
-      Serial.print("Version from file: ");
-      Serial.print(CONFIG.data.version);
-      Serial.print(";  expected version: ");
-      Serial.println(CONFIG_VERSION);
-      if (CONFIG.data.version == CONFIG_VERSION) {
-        Serial.println("config loaded");
-        success = true;
-      } else {
-        Serial.println("incorrect config version");
-      }
-    } else {
+    Serial.print("Version from file: ");
+    Serial.print(CONFIG.data.version);
+    Serial.print(";  expected version: ");
+    Serial.println(CONFIG_VERSION);
+
+    if (expected_size == 0) {
+      Serial.println("incorrect config version");
+    } else if (read_size < expected_size) {
       Serial.print("config incorrect size - expected: ");
-      Serial.print(sizeof(CONFIG));
+      Serial.print(expected_size);
       Serial.print(", got: ");
       Serial.println(read_size);
+    } else if (CONFIG.data.version != CONFIG_VERSION) {
+      Serial.println("upgrading config");
+      upgrade_config(CONFIG.data.version);
+      upgraded = true;
+      success = true;
+    } else {
+      Serial.println("config loaded");
+      success = true;
     }
     
     config_file.close();
+    if (upgraded) write_config();
   } else {
     Serial.println("unable to read config");
   }
@@ -70,6 +117,11 @@ void set_default_config() {
   strcpy(CONFIG.data.endpoint_domain, "relay.heatseek.org");
   strcpy(CONFIG.data.endpoint_path, "/temperatures");
   CONFIG.data.endpoint_configured = 1;
+
+  CONFIG.data.batch_size = 1;
+  CONFIG.data.dns_ttl_s = DEFAULT_DNS_TTL_S;
+  CONFIG.data.fona_baud = 0;
+  CONFIG.data.compact_depth = DEFAULT_COMPACT_DEPTH;
 }
 
 int read_input_until_newline(char *message, char *buffer) {
@@ -111,8 +163,16 @@ void print_menu() {
   #ifdef HEATSEEK_FEATHER_WIFI_WICED
     Serial.println("[a] List nearby access points");
   #endif
+  #ifdef TRANSMITTER_WIFI
+    Serial.println("[l] Print WiFi connection stats");
+  #endif
   Serial.println("[i] Setup Cell ID");
   Serial.println("[e] Setup API Endpoint");
+  Serial.println("[b] Set upload batch size");
+  Serial.println("[k] Set backlog compaction depth");
+  #ifdef HEATSEEK_FEATHER_WIFI_M0
+    Serial.println("[n] Set DNS cache time");
+  #endif
   Serial.println("[p] Print config");
   Serial.println("[d] Reset config");
   Serial.println("[s] Exit config");
@@ -156,9 +216,41 @@ void print_config_info() {
   
   Serial.print("reading_interval (seconds): ");
   Serial.println(CONFIG.data.reading_interval_s);
+
+  Serial.print("upload batch size: ");
+  Serial.println(CONFIG.data.batch_size);
+
+  Serial.print("backlog compaction depth: ");
+  if (CONFIG.data.compact_depth) {
+    Serial.println(CONFIG.data.compact_depth);
+  } else {
+    Serial.println("off");
+  }
+
+  #ifdef HEATSEEK_FEATHER_WIFI_M0
+    Serial.print("DNS cache time (seconds): ");
+    Serial.print(CONFIG.data.dns_ttl_s);
+    Serial.print(", hits: ");
+    Serial.print(WiFi.dnsCacheHits());
+    Serial.print(", misses: ");
+    Serial.print(WiFi.dnsCacheMisses());
+    Serial.print(", fallbacks: ");
+    Serial.println(WiFi.dnsCacheFallbacks());
+  #endif
+
+  #ifdef TRANSMITTER_GSM
+    Serial.print("FONA baud rate: ");
+    if (CONFIG.data.fona_baud) {
+      Serial.println(CONFIG.data.fona_baud);
+    } else {
+      Serial.println("not negotiated yet");
+    }
+  #endif
 }
 
 void enter_configuration() {
+  data_log_flush(); // the card may be pulled while we're in here
+
   print_menu();
     
   while(true) {
@@ -286,6 +378,54 @@ void enter_configuration() {
           print_menu();
           break;
         }
+        case 'b': {
+          char buffer[200];
+          int length;
+          
+          length = read_input_until_newline("Enter number of readings to send per request (1 sends each reading on its own)", buffer);
+          buffer[length] = '\0';
+          CONFIG.data.batch_size = constrain(strtol(buffer, NULL, 0), 1, BATCH_MAX_SIZE);
+
+          write_config();
+
+          Serial.println("Batch size configured");
+          print_config_info();
+          print_menu();
+          break;
+        }
+        case 'k': {
+          char buffer[200];
+          int length;
+          
+          length = read_input_until_newline("Enter how many queued readings to keep at full resolution before older ones are rolled into hourly summaries (0 never compacts)", buffer);
+          buffer[length] = '\0';
+          CONFIG.data.compact_depth = strtoul(buffer, NULL, 0);
+
+          write_config();
+
+          Serial.println("Compaction depth configured");
+          print_config_info();
+          print_menu();
+          break;
+        }
+#ifdef HEATSEEK_FEATHER_WIFI_M0
+        case 'n': {
+          char buffer[200];
+          int length;
+          
+          length = read_input_until_newline("Enter how long to reuse a looked up server address, in seconds (0 looks it up every time)", buffer);
+          buffer[length] = '\0';
+          CONFIG.data.dns_ttl_s = strtoul(buffer, NULL, 0);
+
+          write_config();
+          WiFi.flushDnsCache();
+
+          Serial.println("DNS cache time configured");
+          print_config_info();
+          print_menu();
+          break;
+        }
+#endif
         case 'd': {
           Serial.println("reseting config");
           set_default_config();
@@ -300,6 +440,12 @@ void enter_configuration() {
           print_config_info();
           break;
         }
+#ifdef TRANSMITTER_WIFI
+        case 'l': {
+          print_link_stats();
+          break;
+        }
+#endif
         case 's': {
           Serial.println("exiting config");
           return;
@@ -357,7 +503,38 @@ void enter_configuration() {
   }
 }
 
-uint32_t get_last_reading_time() {
+// The last reading time is compared against the RTC every pass through
+// loop(), so it's cached in RAM and only written through to time.bin when it
+// changes.  A copy is kept in retained RAM so a warm reboot (e.g. from the
+// watchdog) doesn't have to read it back from the SD card.
+#define RETAINED_TIME_MAGIC 0x54494d45 // "TIME"
+
+typedef struct {
+  uint32_t magic;
+  uint32_t timestamp;
+  uint32_t checksum;
+} retained_time_struct;
+
+static retained_time_struct retained_time RETAINED;
+static uint32_t last_reading_time = 0;
+static bool last_reading_time_loaded = false;
+
+static void retain_last_reading_time() {
+  retained_time.magic = RETAINED_TIME_MAGIC;
+  retained_time.timestamp = last_reading_time;
+  retained_time.checksum = retained_checksum(&retained_time, offsetof(retained_time_struct, checksum));
+}
+
+static bool restore_last_reading_time() {
+  if (!RETAINED_RAM) return false;
+  if (retained_time.magic != RETAINED_TIME_MAGIC) return false;
+  if (retained_time.checksum != retained_checksum(&retained_time, offsetof(retained_time_struct, checksum))) return false;
+
+  last_reading_time = retained_time.timestamp;
+  return true;
+}
+
+static uint32_t read_last_reading_time() {
   File reading_time_file;
   uint8_t data[4];
 
@@ -372,7 +549,23 @@ uint32_t get_last_reading_time() {
   return data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
 }
 
+uint32_t get_last_reading_time() {
+  if (!last_reading_time_loaded) {
+    if (restore_last_reading_time()) {
+      Serial.println("restored last reading time from retained RAM");
+    } else {
+      last_reading_time = read_last_reading_time();
+      retain_last_reading_time();
+    }
+    last_reading_time_loaded = true;
+  }
+
+  return last_reading_time;
+}
+
 void update_last_reading_time(uint32_t timestamp) {
+  if (last_reading_time_loaded && timestamp == last_reading_time) return;
+
   uint8_t data[4];
 
   data[0] = (timestamp & 0x000000ff);
@@ -390,6 +583,10 @@ void update_last_reading_time(uint32_t timestamp) {
     while(true); // watchdog will reboot
   }
 
+  last_reading_time = timestamp;
+  last_reading_time_loaded = true;
+  retain_last_reading_time();
+
   Serial.println("updated last reading time");
 }
 
@@ -1,7 +1,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-#define CONFIG_VERSION     6
+#define CONFIG_VERSION     10
 
 typedef struct {
   uint16_t version;
@@ -20,6 +20,18 @@ typedef struct {
   uint8_t endpoint_configured;
   char endpoint_domain[100];
   char endpoint_path[100];
+
+  // added in version 7
+  uint8_t batch_size;
+
+  // added in version 8
+  uint32_t dns_ttl_s;
+
+  // added in version 9
+  uint32_t fona_baud;  // 0 until a rate has been negotiated
+
+  // added in version 10
+  uint32_t compact_depth;  // raw readings kept before compacting; 0 never compacts
 } CONFIG_struct;
 
 typedef union {
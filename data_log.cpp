@@ -0,0 +1,247 @@
+#include <stddef.h>
+#include <SD.h>
+#include <RTClib.h>
+#include "data_log.h"
+#include "config.h"
+#include "watchdog.h"
+
+#define DATA_LOG_DIR           "data"
+#define DATA_LOG_MAGIC         0x48534c31  // "HSL1"
+#define DATA_LOG_BUFFER_MAGIC  0x48534c42  // "HSLB"
+
+// Readings are logged into one file per month, data/YYYYMM.bin.  Each is
+// filled with zeros up front, sized for a month at the current reading
+// interval, so appends never allocate clusters or grow the directory entry,
+// and the file is kept open so writes never walk the cluster chain from the
+// start.  Should the interval shrink mid month the file simply grows past
+// its preallocated size.
+//
+// A file starts with this header, followed by packed_reading records.  The
+// records are in time order, so the end of the data is the first record
+// with a zero timestamp.
+typedef struct {
+  uint32_t magic;
+  uint16_t reading_version;
+  uint16_t record_size;
+} data_log_header;
+
+// A copy of the last, partly written sector of the current month's file.
+// Readings are added to it in RAM and the sector is written back when it
+// fills up, when its oldest unwritten reading reaches DATA_LOG_MAX_AGE_S,
+// or on data_log_flush().  It is kept in retained RAM so anything not yet
+// written when the watchdog fires is written at the next startup.
+typedef struct {
+  uint32_t magic;
+  uint32_t extent;            // YYYYMM of the file the sector belongs to
+  uint32_t sector_offset;     // file offset of sector[0]
+  uint16_t length;            // bytes of sector in use
+  uint16_t flushed;           // bytes of sector already on the card
+  uint32_t oldest_unflushed;  // time of the first reading not on the card, or 0
+  uint8_t sector[DATA_LOG_SECTOR_SIZE];
+  uint32_t checksum;
+} data_log_buffer;
+
+static data_log_buffer buffer RETAINED;
+static File data_file;
+static uint32_t open_extent_id = 0;
+
+static uint32_t buffer_checksum() {
+  return retained_checksum(&buffer, offsetof(data_log_buffer, checksum));
+}
+
+static void save_buffer() {
+  buffer.magic = DATA_LOG_BUFFER_MAGIC;
+  buffer.checksum = buffer_checksum();
+}
+
+static bool buffer_valid() {
+  return buffer.magic == DATA_LOG_BUFFER_MAGIC &&
+         buffer.checksum == buffer_checksum() &&
+         buffer.length <= DATA_LOG_SECTOR_SIZE &&
+         buffer.flushed <= buffer.length;
+}
+
+static uint32_t extent_for(uint32_t time) {
+  DateTime date(time);
+  return date.year() * 100UL + date.month();
+}
+
+// Room for a month of readings at the current interval, plus a sector spare.
+static uint32_t extent_size(uint32_t extent) {
+  uint16_t year = extent / 100;
+  uint8_t month = extent % 100;
+
+  DateTime start(year, month, 1);
+  DateTime end = month == 12 ? DateTime(year + 1, 1, 1) : DateTime(year, month + 1, 1);
+  uint32_t interval_s = max(CONFIG.data.reading_interval_s, (int32_t) 1);
+  uint32_t readings = (end.unixtime() - start.unixtime()) / interval_s;
+
+  uint32_t size = sizeof(data_log_header) + readings * sizeof(packed_reading) + DATA_LOG_SECTOR_SIZE;
+  return size + DATA_LOG_SECTOR_SIZE - size % DATA_LOG_SECTOR_SIZE;
+}
+
+// Carries on from wherever an earlier attempt stopped, e.g. on a reset.
+static void preallocate(uint32_t size) {
+  Serial.println("preallocating data log...");
+
+  uint8_t zeros[DATA_LOG_SECTOR_SIZE];
+  memset(zeros, 0, sizeof(zeros));
+
+  uint32_t written = data_file.size();
+  data_file.seek(written);
+
+  if (written == 0) {
+    data_log_header header;
+    header.magic = DATA_LOG_MAGIC;
+    header.reading_version = READING_VERSION;
+    header.record_size = sizeof(packed_reading);
+
+    data_file.write((uint8_t *) &header, sizeof(header));
+    written = sizeof(header);
+  }
+
+  while (written < size) {
+    uint32_t chunk = min(size - written, (uint32_t) sizeof(zeros));
+    data_file.write(zeros, chunk);
+    written += chunk;
+    watchdog_feed();
+  }
+
+  data_file.flush();
+  Serial.println("preallocated data log");
+}
+
+static void extent_path(char *path, uint32_t extent) {
+  sprintf(path, DATA_LOG_DIR "/%lu.bin", (unsigned long) extent);
+}
+
+static void open_extent(uint32_t extent) {
+  char path[32];
+  extent_path(path, extent);
+
+  if (data_file) data_file.close();
+
+  // not FILE_WRITE, whose O_APPEND would put every write after the
+  // preallocated zeros instead of at the sector being rewritten
+  if (!(data_file = SD.open(path, O_READ | O_WRITE | O_CREAT))) {
+    Serial.print("unable to open ");
+    Serial.println(path);
+    while(true); // watchdog will reboot
+  }
+
+  open_extent_id = extent;
+
+  uint32_t size = extent_size(extent);
+  if (data_file.size() < size) preallocate(size);
+}
+
+// Binary search for the first empty record slot.
+static uint32_t find_end() {
+  uint32_t low = 0;
+  uint32_t high = (data_file.size() - sizeof(data_log_header)) / sizeof(packed_reading);
+
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    uint32_t time = 0;
+
+    data_file.seek(sizeof(data_log_header) + middle * sizeof(packed_reading));
+    data_file.read(&time, sizeof(time));
+
+    if (time != 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return sizeof(data_log_header) + low * sizeof(packed_reading);
+}
+
+// Start appending to extent, loading the sector its data ends in.
+static void load_extent(uint32_t extent) {
+  open_extent(extent);
+
+  uint32_t end = find_end();
+
+  buffer.extent = extent;
+  buffer.sector_offset = end - end % DATA_LOG_SECTOR_SIZE;
+  buffer.length = end - buffer.sector_offset;
+  buffer.flushed = buffer.length;
+  buffer.oldest_unflushed = 0;
+
+  data_file.seek(buffer.sector_offset);
+  data_file.read(buffer.sector, buffer.length);
+
+  save_buffer();
+}
+
+static void write_sector() {
+  data_file.seek(buffer.sector_offset);
+  data_file.write(buffer.sector, buffer.length);
+  data_file.flush();
+
+  buffer.flushed = buffer.length;
+  buffer.oldest_unflushed = 0;
+  save_buffer();
+
+  Serial.println("wrote readings to SD");
+}
+
+void data_log_initialize() {
+  if (!SD.exists(DATA_LOG_DIR)) SD.mkdir(DATA_LOG_DIR);
+
+  if (!RETAINED_RAM || !buffer_valid()) return;
+
+  // Only write the sector back into the file it came from.  Creating or
+  // preallocating one here would put the sector after a run of zeros,
+  // which find_end() takes for the end of the data.
+  char path[32];
+  extent_path(path, buffer.extent);
+  data_file = SD.open(path, O_READ | O_WRITE);
+
+  if (!data_file || data_file.size() < buffer.sector_offset + buffer.flushed) {
+    // not the card the buffer was written against
+    buffer.magic = 0;
+    if (data_file) data_file.close();
+    return;
+  }
+
+  open_extent_id = buffer.extent;
+
+  if (buffer.flushed < buffer.length) {
+    Serial.println("writing readings kept across reset");
+    write_sector();
+  }
+}
+
+void data_log_append(packed_reading *reading) {
+  uint32_t extent = extent_for(reading->data.time);
+
+  if (!data_file || extent != open_extent_id) {
+    data_log_flush();
+    load_extent(extent);
+  }
+
+  if (buffer.length + sizeof(reading->raw) > DATA_LOG_SECTOR_SIZE) {
+    if (buffer.flushed < buffer.length) write_sector();
+
+    buffer.sector_offset += buffer.length;
+    buffer.length = 0;
+    buffer.flushed = 0;
+  }
+
+  memcpy(buffer.sector + buffer.length, reading->raw, sizeof(reading->raw));
+  buffer.length += sizeof(reading->raw);
+  if (buffer.oldest_unflushed == 0) buffer.oldest_unflushed = reading->data.time;
+  save_buffer();
+
+  if (buffer.length == DATA_LOG_SECTOR_SIZE ||
+      reading->data.time - buffer.oldest_unflushed >= DATA_LOG_MAX_AGE_S) {
+    write_sector();
+  }
+}
+
+// Write out anything still buffered, e.g. before the card may be pulled.
+void data_log_flush() {
+  if (data_file && buffer.flushed < buffer.length) write_sector();
+}
@@ -0,0 +1,19 @@
+#ifndef DATA_LOG_H
+#define DATA_LOG_H
+
+#include <Arduino.h>
+#include "reading.h"
+#include "retained.h"
+
+#define DATA_LOG_SECTOR_SIZE  512
+
+// Longest a reading may sit in RAM before it is written to the card.
+// Retained RAM survives a watchdog reset but not a power cut or a pulled
+// battery, so this is how much of the log those can lose.
+#define DATA_LOG_MAX_AGE_S  (60 * 60)
+
+void data_log_initialize();
+void data_log_append(packed_reading *reading);
+void data_log_flush();
+
+#endif
@@ -0,0 +1,16 @@
+#include "heap.h"
+#include <malloc.h>
+
+// malloc only ever grows the arena it takes from sbrk, so the arena size is
+// the most heap that has been in use at once since boot.
+uint32_t heap_peak_bytes() {
+  return mallinfo().arena;
+}
+
+void heap_report() {
+  struct mallinfo info = mallinfo();
+
+  Serial.print("heap in use: "); Serial.print(info.uordblks);
+  Serial.print(" bytes, peak: "); Serial.print(info.arena);
+  Serial.println(" bytes");
+}
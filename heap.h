@@ -0,0 +1,9 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <Arduino.h>
+
+void heap_report();
+uint32_t heap_peak_bytes();
+
+#endif
@@ -7,9 +7,15 @@
 #include "config.h"
 #include "watchdog.h"
 #include "rtc.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "reading.h"
+#include "data_log.h"
+#include "summary.h"
 
 static DHT dht(DHT_DATA, DHT22);
 uint32_t startup_millis = 0;
+uint32_t next_drain_time = 0;
 
 void setup() {
   watchdog_init();
@@ -25,12 +31,18 @@ void setup() {
   #endif
 
   initialize_sd();
+  queue_initialize();
+  summary_initialize();
+  transmit_initialize();
   rtc_initialize();
 
   dht.begin();
 
   if (!read_config()) set_default_config();
 
+  // files are sized from the reading interval, so only once it is known
+  data_log_initialize();
+
   watchdog_feed();
 
   startup_millis = millis();
@@ -39,7 +51,7 @@ void setup() {
 void loop() {
   float temperature_f;
   float humidity;
-  float heat_index;
+  packed_reading reading;
 
   int32_t current_time = rtc.now().unixtime();
   int32_t last_reading_time = get_last_reading_time();
@@ -49,56 +61,97 @@ void loop() {
   if (command == 'C') {
     enter_configuration();
   }
-      
-  Serial.print("Time since last reading: ");
-  Serial.print(time_since_last_reading);
-  Serial.print(", reading_interval: ");
-  Serial.print(CONFIG.data.reading_interval_s);
-  Serial.print(".  Code version: ");
-  Serial.print(CODE_VERSION);
-  Serial.println(". Press 'C' to enter config.");
 
   if (millis() - startup_millis < 15000) {
+    print_status(time_since_last_reading);
     Serial.println("Allowing 15 seconds to enter config mode [C] before taking first reading.");
     watchdog_feed();
     delay(2000);
     return;
   }
-  
-  if (CONFIG.data.reading_interval_s - time_since_last_reading > SEND_SAVED_READINGS_THRESHOLD) {
-    Serial.println("Checking for queued temperature readings");
+
+  // Readings always come first; an upload in progress just picks up where
+  // it left off on the next pass.
+  if (time_since_last_reading >= CONFIG.data.reading_interval_s) {
+    print_status(time_since_last_reading);
     watchdog_feed();
-    transmit_queued_temps();
-    delay(2000);
+
+    read_temperatures(&temperature_f, &humidity);
+    reading_pack(&reading, current_time, temperature_f, humidity);
+
+    Serial.print("Heat index: ");
+    Serial.println(reading_heat_index(&reading));
+
+    data_log_append(&reading);
+
     watchdog_feed();
-    return;
-  } else if (time_since_last_reading < CONFIG.data.reading_interval_s) {
-    delay(2000);
+
+    update_last_reading_time(current_time);
     watchdog_feed();
+
+    transmit(&reading);
+
+    watchdog_feed();
+
+    scheduler_report_duty_cycle();
     return;
   }
-  
-  watchdog_feed();
 
-  read_temperatures(&temperature_f, &humidity, &heat_index);
-  log_to_sd(temperature_f, humidity, heat_index, current_time);
+  if (transmit_busy()) {
+    if (transmit_step() == DRAIN_FAILED) {
+      uint32_t retry_delay_s = transmit_retry_delay_s();
+      next_drain_time = current_time + retry_delay_s;
 
-  watchdog_feed();
-  
-  update_last_reading_time(current_time);
-  watchdog_feed();
-  
-  transmit(temperature_f, humidity, heat_index, current_time);
+      Serial.print("retrying queued readings in ");
+      Serial.print(retry_delay_s);
+      Serial.println(" seconds");
+    }
+    return;
+  }
 
-  watchdog_feed();
+  compact_backlog();
 
-  delay(2000);
+  print_status(time_since_last_reading);
+
+  uint32_t next_reading_time = last_reading_time + CONFIG.data.reading_interval_s;
+  bool drain_window_open = CONFIG.data.reading_interval_s - time_since_last_reading > SEND_SAVED_READINGS_THRESHOLD;
+
+  if (drain_window_open && transmit_pending() && (uint32_t) current_time >= next_drain_time) {
+    Serial.println("Checking for queued temperature readings");
+    transmit_start();
+    return;
+  }
+
+  uint32_t wake_time = next_reading_time;
+  uint32_t drain_time = max(next_drain_time, (uint32_t) current_time);
+
+  // wake early for the next backlog drain if it falls inside the window
+  if (transmit_pending() && (int32_t) (next_reading_time - drain_time) > SEND_SAVED_READINGS_THRESHOLD) {
+    wake_time = drain_time;
+  }
+
+  scheduler_sleep_until(wake_time);
+}
+
+void print_status(int32_t time_since_last_reading) {
+  Serial.print("Time since last reading: ");
+  Serial.print(time_since_last_reading);
+  Serial.print(", reading_interval: ");
+  Serial.print(CONFIG.data.reading_interval_s);
+  Serial.print(".  Code version: ");
+  Serial.print(CODE_VERSION);
+  Serial.println(". Press 'C' to enter config.");
 }
 
-void read_temperatures(float *temperature_f, float *humidity, float *heat_index) {
+void read_temperatures(float *temperature_f, float *humidity) {
   while (true) {
     bool success = true;
 
+    // the conversion runs off a pin interrupt, so radio and UART interrupts
+    // keep being serviced while we wait for it
+    dht.startRead();
+    while (dht.poll() == DHT_BUSY);
+
     *temperature_f = dht.readTemperature(true);
     *humidity = dht.readHumidity();
     
@@ -115,11 +168,6 @@ void read_temperatures(float *temperature_f, float *humidity, float *heat_index)
       Serial.print("Humidity: ");
       Serial.print(*humidity);
       Serial.println("%");
-      
-      *heat_index = dht.computeHeatIndex(*temperature_f, *humidity);
-      
-      Serial.print("Heat index: ");
-      Serial.println(*heat_index);
 
       return;
       
@@ -134,24 +182,6 @@ void read_temperatures(float *temperature_f, float *humidity, float *heat_index)
   }
 }
 
-void log_to_sd(float temperature_f, float humidity, float heat_index, uint32_t current_time) {
-  Serial.println("writing to SD card...");
-  
-  File data_file;
-  
-  if (data_file = SD.open("data.csv", FILE_WRITE)) {
-    data_file.print(current_time); data_file.print(",");
-    data_file.print(temperature_f); data_file.print(",");
-    data_file.print(humidity); data_file.print(",");
-    data_file.print(heat_index); data_file.println();
-    Serial.println("wrote to SD");
-    data_file.close();
-  } else {
-    Serial.println("unable to open data.csv");
-    while(true); // watchdog will reboot
-  }
-}
-
 void initialize_sd() {
   // Stop LORA module from interfering with SPI
   #ifdef TRANSMITTER_GSM
@@ -0,0 +1,85 @@
+#include "http_response.h"
+
+void http_response_begin(http_response *response) {
+  response->state = HTTP_RESPONSE_STATUS;
+  response->status = 0;
+  response->body_remaining = -1;
+  response->close = false;
+  response->line_length = 0;
+}
+
+static bool header_is(const char *line, const char *name) {
+  return strncasecmp(line, name, strlen(name)) == 0;
+}
+
+// "HTTP/1.1 200 OK"
+static void parse_status_line(http_response *response) {
+  const char *space = strchr(response->line, ' ');
+
+  if (strncmp(response->line, "HTTP/1.", 7) != 0 || !space) {
+    response->state = HTTP_RESPONSE_ERROR;
+    return;
+  }
+
+  response->status = atoi(space + 1);
+  response->close = response->line[7] == '0';  // HTTP/1.0 closes by default
+  response->state = HTTP_RESPONSE_HEADERS;
+}
+
+// Without a Content-Length the body runs until the server closes the
+// connection, so the response is treated as done at the end of the headers
+// and the connection as unusable.
+static void parse_header_line(http_response *response) {
+  const char *line = response->line;
+
+  if (response->line_length == 0) {
+    if (response->body_remaining < 0) response->close = true;
+    response->state = response->body_remaining > 0 ? HTTP_RESPONSE_BODY : HTTP_RESPONSE_DONE;
+  } else if (header_is(line, "Content-Length:")) {
+    response->body_remaining = strtol(line + 15, NULL, 10);
+  } else if (header_is(line, "Connection:")) {
+    response->close = strstr(line, "close") != NULL || strstr(line, "Close") != NULL;
+  } else if (header_is(line, "Transfer-Encoding:")) {
+    response->body_remaining = -1;
+    response->close = true;
+  }
+}
+
+// Feed the next bytes read from the socket.  Lines too long for the buffer
+// are truncated, which only ever drops header values we don't use.
+http_response_state http_response_feed(http_response *response, const uint8_t *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (response->state == HTTP_RESPONSE_BODY) {
+      size_t body_bytes = min((size_t) response->body_remaining, length - i);
+      response->body_remaining -= body_bytes;
+      i += body_bytes - 1;
+
+      if (response->body_remaining == 0) response->state = HTTP_RESPONSE_DONE;
+      continue;
+    }
+
+    if (response->state != HTTP_RESPONSE_STATUS && response->state != HTTP_RESPONSE_HEADERS) break;
+
+    char c = data[i];
+    if (c == '\r') continue;
+
+    if (c != '\n') {
+      if (response->line_length < sizeof(response->line) - 1) {
+        response->line[response->line_length++] = c;
+      }
+      continue;
+    }
+
+    response->line[response->line_length] = '\0';
+
+    if (response->state == HTTP_RESPONSE_STATUS) {
+      parse_status_line(response);
+    } else {
+      parse_header_line(response);
+    }
+
+    response->line_length = 0;
+  }
+
+  return response->state;
+}
@@ -0,0 +1,29 @@
+#ifndef HTTP_RESPONSE_H
+#define HTTP_RESPONSE_H
+
+#include <Arduino.h>
+
+typedef enum {
+  HTTP_RESPONSE_STATUS,
+  HTTP_RESPONSE_HEADERS,
+  HTTP_RESPONSE_BODY,
+  HTTP_RESPONSE_DONE,
+  HTTP_RESPONSE_ERROR
+} http_response_state;
+
+// Incremental HTTP/1.1 response parser for transports that hand us raw
+// socket bytes.  Only the status code and what's needed to find the end of
+// the response are kept.
+typedef struct {
+  http_response_state state;
+  int status;
+  int32_t body_remaining;  // -1 when the server didn't send Content-Length
+  bool close;              // connection can't be reused after this response
+  char line[64];
+  uint8_t line_length;
+} http_response;
+
+void http_response_begin(http_response *response);
+http_response_state http_response_feed(http_response *response, const uint8_t *data, size_t length);
+
+#endif
@@ -0,0 +1,43 @@
+#include "latency.h"
+
+void latency_record(latency_stats *stats, uint32_t ms) {
+  if (stats->count == 0 || ms < stats->min_ms) stats->min_ms = ms;
+  if (ms > stats->max_ms) stats->max_ms = ms;
+
+  stats->total_ms += ms;
+  stats->count++;
+}
+
+void latency_print(const char *name, latency_stats *stats) {
+  Serial.print(name);
+
+  if (stats->count == 0) {
+    Serial.println(": no samples");
+    return;
+  }
+
+  Serial.print(" (ms): min "); Serial.print(stats->min_ms);
+  Serial.print(", mean "); Serial.print(stats->total_ms / stats->count);
+  Serial.print(", max "); Serial.print(stats->max_ms);
+  Serial.print(" over "); Serial.print(stats->count);
+  Serial.println(" sample(s)");
+}
+
+// The average moves 1/8 and the deviation 1/4 of the way to each sample.
+void latency_estimate_update(latency_estimate *estimate, uint32_t ms) {
+  if (!estimate->primed) {
+    estimate->average_ms = ms;
+    estimate->deviation_ms = ms / 2;
+    estimate->primed = true;
+    return;
+  }
+
+  int32_t error = (int32_t) ms - (int32_t) estimate->average_ms;
+  estimate->average_ms += error / 8;
+  estimate->deviation_ms += ((int32_t) abs(error) - (int32_t) estimate->deviation_ms) / 4;
+}
+
+// A sample should rarely come in above this.  0 until the first sample.
+uint32_t latency_estimate_upper(latency_estimate *estimate) {
+  return estimate->average_ms + 4 * estimate->deviation_ms;
+}
@@ -0,0 +1,25 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <Arduino.h>
+
+typedef struct {
+  uint32_t count;
+  uint32_t min_ms;
+  uint32_t max_ms;
+  uint32_t total_ms;
+} latency_stats;
+
+// Smoothed average and mean deviation, as in TCP's round trip estimator.
+typedef struct {
+  uint32_t average_ms;
+  uint32_t deviation_ms;
+  bool primed;
+} latency_estimate;
+
+void latency_record(latency_stats *stats, uint32_t ms);
+void latency_print(const char *name, latency_stats *stats);
+void latency_estimate_update(latency_estimate *estimate, uint32_t ms);
+uint32_t latency_estimate_upper(latency_estimate *estimate);
+
+#endif
@@ -32,6 +32,9 @@ Adafruit_FONA::Adafruit_FONA(int8_t rst)
   httpsredirect = false;
   useragent = F("FONA");
   ok_reply = F("OK");
+  lastrx = 0;
+  urchead = 0;
+  urccount = 0;
 }
 
 uint8_t Adafruit_FONA::type(void) {
@@ -136,8 +139,13 @@ boolean Adafruit_FONA::begin(Stream &port) {
 
 
 /********* Serial port ********************************************/
-boolean Adafruit_FONA::setBaudrate(uint16_t baud) {
-  return sendCheckReply(F("AT+IPREX="), baud, ok_reply);
+// The OK comes back at the old rate; the new one applies from the next
+// command.  2G modules take AT+IPR, the 3G ones AT+IPREX.
+boolean Adafruit_FONA::setBaudrate(uint32_t baud) {
+  if (_type == FONA3G_A || _type == FONA3G_E)
+    return sendCheckReply(F("AT+IPREX="), baud, ok_reply);
+
+  return sendCheckReply(F("AT+IPR="), baud, ok_reply);
 }
 
 /********* Real Time Clock ********************************************/
@@ -1381,7 +1389,12 @@ boolean Adafruit_FONA::TCPconnected(void) {
   return (strcmp(replybuffer, "STATE: CONNECT OK") == 0);
 }
 
-boolean Adafruit_FONA::TCPsend(char *packet, uint8_t len) {
+boolean Adafruit_FONA::TCPsend(char *packet, uint16_t len) {
+  while (len > FONA_TCP_CHUNK_SIZE) {
+    if (! TCPsend(packet, FONA_TCP_CHUNK_SIZE)) return false;
+    packet += FONA_TCP_CHUNK_SIZE;
+    len -= FONA_TCP_CHUNK_SIZE;
+  }
 
   DEBUG_PRINT(F("AT+CIPSEND="));
   DEBUG_PRINTLN(len);
@@ -1652,6 +1665,39 @@ void Adafruit_FONA::HTTP_POST_end(void) {
   HTTP_term();
 }
 
+boolean Adafruit_FONA::HTTP_POST_session_start(char *url,
+              FONAFlashStringPtr contenttype) {
+  if (! HTTP_setup(url))
+    return false;
+
+  return HTTP_para(F("CONTENT"), contenttype);
+}
+
+// The HTTP service keeps its parameters between actions, so each post only
+// uploads its data and runs the action.  The response body is left unread.
+boolean Adafruit_FONA::HTTP_POST_session_send(const uint8_t *postdata,
+              uint16_t postdatalen, uint16_t *status, uint16_t *datalen) {
+  // HTTP POST data
+  if (! HTTP_data(postdatalen, 10000))
+    return false;
+  mySerial->write(postdata, postdatalen);
+  if (! expectReply(ok_reply))
+    return false;
+
+  // HTTP POST
+  if (! HTTP_action(FONA_HTTP_POST, status, datalen))
+    return false;
+
+  DEBUG_PRINT(F("Status: ")); DEBUG_PRINTLN(*status);
+  DEBUG_PRINT(F("Len: ")); DEBUG_PRINTLN(*datalen);
+
+  return true;
+}
+
+void Adafruit_FONA::HTTP_POST_session_end(void) {
+  HTTP_term();
+}
+
 void Adafruit_FONA::setUserAgent(FONAFlashStringPtr useragent) {
   this->useragent = useragent;
 }
@@ -1721,18 +1767,91 @@ inline void Adafruit_FONA::flush() {
   mySerial->flush();
 }
 
+// Received bytes are buffered by the UART's receive interrupt, so the
+// readers below only have to drain that buffer; they poll it against a
+// deadline instead of sleeping a millisecond at a time.
+
 void Adafruit_FONA::flushInput() {
-    // Read all available serial input to flush pending data.
-    uint16_t timeoutloop = 0;
-    while (timeoutloop++ < 40) {
-        while(available()) {
-            read();
-            timeoutloop = 0;  // If char was received reset the timer
+    // Throw away stale replies, but keep any unsolicited result codes.
+    char line[FONA_URC_LENGTH];
+    uint8_t lineidx = 0;
+
+    while (available() || millis() - lastrx < FONA_QUIET_MS) {
+        if (readLineBytes(line, sizeof(line), &lineidx, false)) {
+            line[lineidx] = 0;
+            if (isURC(line)) queueURC(line);
+            lineidx = 0;
         }
-        delay(1);
     }
 }
 
+// Move received bytes into buff, starting at *idx.  Returns true once a
+// line is complete (never in multiline mode) or buff is full; a partial
+// line is left in buff for the next call.
+boolean Adafruit_FONA::readLineBytes(char *buff, uint8_t maxlen, uint8_t *idx, boolean multiline) {
+  while (available()) {
+    if (*idx >= maxlen - 1) return true;
+
+    char c = read();
+    lastrx = millis();
+
+    if (c == '\r') continue;
+    if (c == 0xA) {
+      if (*idx == 0)   // the first 0x0A is ignored
+        continue;
+
+      if (!multiline)
+        return true;   // the second 0x0A is the end of the line
+    }
+    buff[(*idx)++] = c;
+  }
+
+  return *idx >= maxlen - 1;
+}
+
+boolean Adafruit_FONA::isURC(const char *line) {
+  static const char * const urcs[] = {
+    "+CMTI:", "+CPIN:", "+CFUN:", "+PDP: DEACT", "Call Ready", "SMS Ready",
+    "RDY", "UNDER-VOLTAGE", "OVER-VOLTAGE", "NORMAL POWER DOWN",
+    "CLOSED", "+CIPRXGET: 1"
+  };
+
+  for (uint8_t i = 0; i < sizeof(urcs) / sizeof(urcs[0]); i++) {
+    if (strncmp(line, urcs[i], strlen(urcs[i])) == 0) return true;
+  }
+  return false;
+}
+
+// When the queue is full the oldest code is dropped.
+void Adafruit_FONA::queueURC(const char *line) {
+  DEBUG_PRINT(F("\t<urc ")); DEBUG_PRINTLN(line);
+
+  if (urccount == FONA_URC_QUEUE_SIZE) {
+    urchead = (urchead + 1) % FONA_URC_QUEUE_SIZE;
+    urccount--;
+  }
+
+  char *slot = urcqueue[(urchead + urccount) % FONA_URC_QUEUE_SIZE];
+  strncpy(slot, line, FONA_URC_LENGTH - 1);
+  slot[FONA_URC_LENGTH - 1] = 0;
+  urccount++;
+}
+
+uint8_t Adafruit_FONA::URCavailable(void) {
+  return urccount;
+}
+
+boolean Adafruit_FONA::readURC(char *buff, uint8_t maxlen) {
+  if (urccount == 0) return false;
+
+  strncpy(buff, urcqueue[urchead], maxlen - 1);
+  buff[maxlen - 1] = 0;
+
+  urchead = (urchead + 1) % FONA_URC_QUEUE_SIZE;
+  urccount--;
+  return true;
+}
+
 uint16_t Adafruit_FONA::readRaw(uint16_t b) {
   uint16_t idx = 0;
 
@@ -1744,41 +1863,26 @@ uint16_t Adafruit_FONA::readRaw(uint16_t b) {
     }
   }
   replybuffer[idx] = 0;
+  lastrx = millis();
 
   return idx;
 }
 
+// Unsolicited result codes that arrive while waiting are queued and the
+// wait goes on for the actual reply.
 uint8_t Adafruit_FONA::readline(uint16_t timeout, boolean multiline) {
-  uint16_t replyidx = 0;
+  uint8_t replyidx = 0;
+  uint32_t start = millis();
 
-  while (timeout--) {
-    if (replyidx >= 254) {
-      //DEBUG_PRINTLN(F("SPACE"));
-      break;
-    }
-
-    while(mySerial->available()) {
-      char c =  mySerial->read();
-      if (c == '\r') continue;
-      if (c == 0xA) {
-        if (replyidx == 0)   // the first 0x0A is ignored
-          continue;
+  while (millis() - start < timeout) {
+    if (readLineBytes(replybuffer, sizeof(replybuffer), &replyidx, multiline)) {
+      replybuffer[replyidx] = 0;
+      if (multiline || replyidx == sizeof(replybuffer) - 1 || !isURC(replybuffer))
+        break;
 
-        if (!multiline) {
-          timeout = 0;         // the second 0x0A is the end of the line
-          break;
-        }
-      }
-      replybuffer[replyidx] = c;
-      //DEBUG_PRINT(c, HEX); DEBUG_PRINT("#"); DEBUG_PRINTLN(c);
-      replyidx++;
-    }
-
-    if (timeout == 0) {
-      //DEBUG_PRINTLN(F("TIMEOUT"));
-      break;
+      queueURC(replybuffer);
+      replyidx = 0;
     }
-    delay(1);
   }
   replybuffer[replyidx] = 0;  // null term
   return replyidx;
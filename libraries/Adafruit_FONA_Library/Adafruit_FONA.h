@@ -54,6 +54,17 @@
 
 #define FONA_DEFAULT_TIMEOUT_MS 500
 
+// Unsolicited result codes are queued until read with readURC()
+#define FONA_URC_QUEUE_SIZE 4
+#define FONA_URC_LENGTH 64
+
+// flushInput() waits for this long after the last received byte, so the
+// tail of a reply can't be taken for the answer to the next command
+#define FONA_QUIET_MS 20
+
+// TCPsend() splits longer packets into AT+CIPSEND calls of this size
+#define FONA_TCP_CHUNK_SIZE 1024
+
 #define FONA_HTTP_GET   0
 #define FONA_HTTP_POST  1
 #define FONA_HTTP_HEAD  2
@@ -78,7 +89,7 @@ class Adafruit_FONA : public FONAStreamType {
   void flush();
 
   // FONA 3G requirements
-  boolean setBaudrate(uint16_t baud);
+  boolean setBaudrate(uint32_t baud);
 
   // RTC
   boolean enableRTC(uint8_t i);
@@ -146,7 +157,7 @@ class Adafruit_FONA : public FONAStreamType {
   boolean TCPconnect(char *server, uint16_t port);
   boolean TCPclose(void);
   boolean TCPconnected(void);
-  boolean TCPsend(char *packet, uint8_t len);
+  boolean TCPsend(char *packet, uint16_t len);
   uint16_t TCPavailable(void);
   uint16_t TCPread(uint8_t *buff, uint8_t len);
 
@@ -170,6 +181,11 @@ class Adafruit_FONA : public FONAStreamType {
   void HTTP_POST_end(void);
   void setUserAgent(FONAFlashStringPtr useragent);
 
+  // HTTP POST session: set up once, then only the data and action per post.
+  boolean HTTP_POST_session_start(char *url, FONAFlashStringPtr contenttype);
+  boolean HTTP_POST_session_send(const uint8_t *postdata, uint16_t postdatalen, uint16_t *status, uint16_t *datalen);
+  void HTTP_POST_session_end(void);
+
   // HTTPS
   void setHTTPSRedirect(boolean onoff);
 
@@ -184,6 +200,10 @@ class Adafruit_FONA : public FONAStreamType {
   boolean callerIdNotification(boolean enable, uint8_t interrupt = 0);
   boolean incomingCallNumber(char* phonenum);
 
+  // Unsolicited result codes
+  uint8_t URCavailable(void);
+  boolean readURC(char *buff, uint8_t maxlen);
+
   // Helper functions to verify responses.
   boolean expectReply(FONAFlashStringPtr reply, uint16_t timeout = 10000);
   boolean sendCheckReply(char *send, char *reply, uint16_t timeout = FONA_DEFAULT_TIMEOUT_MS);
@@ -196,6 +216,10 @@ class Adafruit_FONA : public FONAStreamType {
   uint8_t _type;
 
   char replybuffer[255];
+  uint32_t lastrx;
+  char urcqueue[FONA_URC_QUEUE_SIZE][FONA_URC_LENGTH];
+  uint8_t urchead;
+  uint8_t urccount;
   FONAFlashStringPtr apn;
   FONAFlashStringPtr apnusername;
   FONAFlashStringPtr apnpassword;
@@ -207,6 +231,9 @@ class Adafruit_FONA : public FONAStreamType {
   boolean HTTP_setup(char *url);
 
   void flushInput();
+  boolean readLineBytes(char *buff, uint8_t maxlen, uint8_t *idx, boolean multiline);
+  boolean isURC(const char *line);
+  void queueURC(const char *line);
   uint16_t readRaw(uint16_t b);
   uint8_t readline(uint16_t timeout = FONA_DEFAULT_TIMEOUT_MS, boolean multiline = false);
   uint8_t getReply(char *send, uint16_t timeout = FONA_DEFAULT_TIMEOUT_MS);
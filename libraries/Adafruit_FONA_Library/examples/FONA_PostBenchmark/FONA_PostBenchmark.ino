@@ -0,0 +1,183 @@
+/***************************************************
+  This example compares the cost of posting readings through the SIM800's
+  HTTP service (AT+HTTPDATA / AT+HTTPACTION) with writing the same HTTP/1.1
+  request over a kept-alive TCP socket (AT+CIPSEND).
+
+  Each path posts POSTS requests of READINGS_PER_POST readings and prints
+  the average time per request and per reading.  Set the APN, host and
+  path below to a server that accepts form posts.
+
+  Written for the Feather M0 with a FONA on Serial1.
+  BSD license, all text above must be included in any redistribution
+ ****************************************************/
+
+#include "Adafruit_FONA.h"
+
+#define FONA_RST 4
+#define FONA_BAUD 4800
+
+#define HOST "relay.heatseek.org"
+#define PATH "/temperatures"
+#define PORT 80
+
+#define POSTS 10
+#define READINGS_PER_POST 5
+
+HardwareSerial *fonaSerial = &Serial1;
+Adafruit_FONA fona = Adafruit_FONA(FONA_RST);
+
+char body[512];
+char request[768];
+
+void setup() {
+  while (!Serial);
+
+  Serial.begin(115200);
+  Serial.println(F("FONA post benchmark"));
+
+  fonaSerial->begin(FONA_BAUD);
+  if (! fona.begin(*fonaSerial)) {
+    Serial.println(F("Couldn't find FONA"));
+    while (1);
+  }
+
+  // fona.setGPRSNetworkSettings(F("your APN"), F("your username"), F("your password"));
+
+  while (! fona.enableGPRS(true)) {
+    Serial.println(F("Waiting for GPRS..."));
+    delay(2000);
+  }
+
+  int body_length = buildBody();
+
+  Serial.print(F("body: ")); Serial.print(body_length); Serial.print(F(" bytes, "));
+  Serial.print(READINGS_PER_POST); Serial.println(F(" readings"));
+
+  printCost(F("AT+HTTP: "), benchmarkHttpService(body_length));
+  printCost(F("raw TCP: "), benchmarkRawTcp(body_length));
+}
+
+void loop() {
+}
+
+// A batch shaped like the ones the heatseek sensor sends
+int buildBody() {
+  int length = snprintf(body, sizeof(body),
+                        "hub=featherhub&cell=benchmark&sp=300&cell_version=F-1.2.0&count=%d&readings=",
+                        READINGS_PER_POST);
+
+  for (int i = 0; i < READINGS_PER_POST; i++) {
+    length += snprintf(body + length, sizeof(body) - length, "%s%lu,70.100,40.200,69.800",
+                       i > 0 ? ";" : "", 1500000000UL + i * 300UL);
+  }
+
+  return length;
+}
+
+unsigned long benchmarkHttpService(int body_length) {
+  uint16_t status, datalen;
+  int ok = 0;
+
+  unsigned long start = millis();
+
+  if (! fona.HTTP_POST_session_start((char *)HOST PATH, F("application/x-www-form-urlencoded"))) {
+    Serial.println(F("AT+HTTP: session setup failed"));
+    return 0;
+  }
+
+  for (int i = 0; i < POSTS; i++) {
+    if (fona.HTTP_POST_session_send((uint8_t *)body, body_length, &status, &datalen) && status == 200) ok++;
+  }
+
+  fona.HTTP_POST_session_end();
+
+  unsigned long elapsed = millis() - start;
+  printSuccesses(ok);
+  return elapsed;
+}
+
+unsigned long benchmarkRawTcp(int body_length) {
+  int ok = 0;
+
+  int length = snprintf(request, sizeof(request),
+                        "POST " PATH " HTTP/1.1\r\n"
+                        "Host: " HOST "\r\n"
+                        "Content-Type: application/x-www-form-urlencoded\r\n"
+                        "Content-Length: %d\r\n"
+                        "\r\n%s", body_length, body);
+
+  unsigned long start = millis();
+
+  if (! fona.TCPconnect((char *)HOST, PORT)) {
+    Serial.println(F("raw TCP: connect failed"));
+    return 0;
+  }
+
+  for (int i = 0; i < POSTS; i++) {
+    if (fona.TCPsend(request, length) && readStatus() == 200) ok++;
+  }
+
+  fona.TCPclose();
+
+  unsigned long elapsed = millis() - start;
+  printSuccesses(ok);
+  return elapsed;
+}
+
+// Reads the whole response and returns its status code.  The relay always
+// sends a Content-Length, which is all this needs to find the end.
+int readStatus() {
+  char line[80];
+  uint8_t line_length = 0;
+  int status = 0;
+  long content_length = 0;
+  bool in_body = false;
+  unsigned long start = millis();
+
+  while (millis() - start < 30000) {
+    uint16_t available = fona.TCPavailable();
+    if (available == 0) continue;
+
+    uint8_t buffer[64];
+    uint16_t read_size = fona.TCPread(buffer, min(available, (uint16_t)sizeof(buffer)));
+
+    for (uint16_t i = 0; i < read_size; i++) {
+      if (in_body) {
+        if (--content_length == 0) return status;
+        continue;
+      }
+
+      char c = buffer[i];
+      if (c == '\r') continue;
+      if (c != '\n') {
+        if (line_length < sizeof(line) - 1) line[line_length++] = c;
+        continue;
+      }
+
+      line[line_length] = 0;
+      if (status == 0) status = atoi(line + 9);  // "HTTP/1.1 200 OK"
+      else if (strncasecmp(line, "Content-Length:", 15) == 0) content_length = atol(line + 15);
+      else if (line_length == 0) {
+        if (content_length == 0) return status;
+        in_body = true;
+      }
+      line_length = 0;
+    }
+  }
+
+  return 0;
+}
+
+void printSuccesses(int ok) {
+  Serial.print(ok); Serial.print(F("/")); Serial.print(POSTS); Serial.println(F(" posts returned 200"));
+}
+
+void printCost(const __FlashStringHelper *label, unsigned long elapsed) {
+  if (elapsed == 0) return;
+
+  Serial.print(label);
+  Serial.print(elapsed / POSTS);
+  Serial.print(F(" ms per post, "));
+  Serial.print(elapsed / (POSTS * READINGS_PER_POST));
+  Serial.println(F(" ms per reading"));
+}
@@ -594,6 +594,39 @@ String HttpClient::responseBody()
     return response;
 }
 
+int HttpClient::responseBody(char* aBuffer, size_t aSize)
+{
+    int bodyLength = contentLength();
+    int consumed = 0;
+
+    // same termination rules as responseBody() above
+    while (iBodyLengthConsumed != bodyLength)
+    {
+        int c = timedRead();
+
+        if (c == -1) {
+            // read timed out, done
+            break;
+        }
+
+        if ((size_t)consumed + 1 < aSize) {
+            aBuffer[consumed] = (char)c;
+        }
+        consumed++;
+    }
+
+    if (aSize > 0) {
+        aBuffer[(size_t)consumed < aSize ? consumed : aSize - 1] = '\0';
+    }
+
+    if (bodyLength > 0 && bodyLength != consumed) {
+        // failure, we did not read in reponse content length bytes
+        return HTTP_ERROR_TIMED_OUT;
+    }
+
+    return consumed;
+}
+
 bool HttpClient::endOfBodyReached()
 {
     if (endOfHeadersReached() && (contentLength() != kNoContentLengthHeader))
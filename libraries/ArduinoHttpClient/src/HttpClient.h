@@ -286,6 +286,18 @@ public:
     */
     String responseBody();
 
+    /** Read the response body into a buffer without allocating
+      Anything that does not fit in the buffer is read and discarded, so the
+      connection can still be reused.  The buffer is always NUL terminated.
+      Also skips response headers if they have not been read already
+      MUST be called after responseStatusCode()
+      @param aBuffer buffer to read the body into
+      @param aSize size of aBuffer, including room for the terminator
+      @return length of the whole body, or HTTP_ERROR_TIMED_OUT if it could
+        not all be read
+    */
+    int responseBody(char* aBuffer, size_t aSize);
+
     /** Enables connection keep-alive mode
     */
     void connectionKeepAlive();
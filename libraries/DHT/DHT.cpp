@@ -8,6 +8,20 @@ written by Adafruit Industries
 
 #define MIN_INTERVAL 2000
 
+// Async conversion states
+#define ASYNC_IDLE     0
+#define ASYNC_START    1  // holding the data line low
+#define ASYNC_RECEIVE  2  // collecting edges from the sensor
+
+// Time between two falling edges is a 50us low pulse plus a ~28us (0) or
+// ~70us (1) high pulse.
+#define BIT_THRESHOLD_US 100
+#define FRAME_TIMEOUT_US 10000
+
+DHT *DHT::_active = NULL;
+volatile uint8_t DHT::_edgeCount = 0;
+volatile uint32_t DHT::_edges[DHT_EDGES];
+
 DHT::DHT(uint8_t pin, uint8_t type, uint8_t count) {
   _pin = pin;
   _type = type;
@@ -17,6 +31,8 @@ DHT::DHT(uint8_t pin, uint8_t type, uint8_t count) {
   #endif
   _maxcycles = microsecondsToClockCycles(1000);  // 1 millisecond timeout for
                                                  // reading pulses from DHT sensor.
+  _asyncState = ASYNC_IDLE;
+  _callback = NULL;
   // Note that count is now ignored as the DHT reading algorithm adjusts itself
   // basd on the speed of the processor.
 }
@@ -257,3 +273,112 @@ uint32_t DHT::expectPulse(bool level) {
 
   return count;
 }
+
+boolean DHT::startRead(void) {
+  if (_asyncState != ASYNC_IDLE || _active != NULL) {
+    return false;
+  }
+
+  // Too soon after the last conversion; poll() hands back the last result.
+  if ((millis() - _lastreadtime) < MIN_INTERVAL) {
+    _asyncState = ASYNC_RECEIVE;
+    _asyncStart = micros() - FRAME_TIMEOUT_US;
+    return true;
+  }
+
+  _lastreadtime = millis();
+  data[0] = data[1] = data[2] = data[3] = data[4] = 0;
+
+  // Start signal: hold the data line low for at least 1ms (18ms for a DHT11).
+  pinMode(_pin, OUTPUT);
+  digitalWrite(_pin, LOW);
+
+  _active = this;
+  _asyncStart = micros();
+  _asyncState = ASYNC_START;
+  return true;
+}
+
+uint8_t DHT::poll(void) {
+  switch (_asyncState) {
+  case ASYNC_IDLE:
+    return _lastresult ? DHT_OK : DHT_ERROR;
+
+  case ASYNC_START: {
+    uint32_t startLength = (_type == DHT11) ? 20000 : 1100;
+    if ((micros() - _asyncStart) < startLength) {
+      return DHT_BUSY;
+    }
+
+    // Release the line and let the sensor answer.
+    _edgeCount = 0;
+    _asyncStart = micros();
+    _asyncState = ASYNC_RECEIVE;
+    pinMode(_pin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(_pin), edgeInterrupt, FALLING);
+    return DHT_BUSY;
+  }
+
+  case ASYNC_RECEIVE:
+    if (_active != this) {
+      // cached result from startRead()
+      _asyncState = ASYNC_IDLE;
+      return _lastresult ? DHT_OK : DHT_ERROR;
+    }
+
+    if (_edgeCount < DHT_EDGES && (micros() - _asyncStart) < FRAME_TIMEOUT_US) {
+      return DHT_BUSY;
+    }
+
+    detachInterrupt(digitalPinToInterrupt(_pin));
+
+    // The sensor's response edge can be missed if it comes before the
+    // interrupt is attached, but the 41 edges around the bits are enough.
+    if (_edgeCount < DHT_EDGES - 1) {
+      DEBUG_PRINT(F("Timeout waiting for pulses, got edges: ")); DEBUG_PRINTLN(_edgeCount);
+      return finishRead(false);
+    }
+
+    // bit i runs from edge first+i to first+i+1
+    {
+      uint8_t first = _edgeCount - (DHT_EDGES - 1);
+      for (int i=0; i<40; ++i) {
+        data[i/8] <<= 1;
+        if ((_edges[first+i+1] - _edges[first+i]) > BIT_THRESHOLD_US) {
+          data[i/8] |= 1;
+        }
+      }
+    }
+
+    if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
+      DEBUG_PRINTLN(F("Checksum failure!"));
+      return finishRead(false);
+    }
+
+    return finishRead(true);
+  }
+
+  return DHT_ERROR;
+}
+
+void DHT::onRead(void (*callback)(DHT &dht, boolean success)) {
+  _callback = callback;
+}
+
+uint8_t DHT::finishRead(boolean success) {
+  _lastresult = success;
+  _asyncState = ASYNC_IDLE;
+  _active = NULL;
+
+  if (_callback) {
+    _callback(*this, success);
+  }
+
+  return success ? DHT_OK : DHT_ERROR;
+}
+
+void DHT::edgeInterrupt(void) {
+  if (_edgeCount < DHT_EDGES) {
+    _edges[_edgeCount++] = micros();
+  }
+}
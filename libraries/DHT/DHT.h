@@ -34,6 +34,15 @@ written by Adafruit Industries
 #define DHT21 21
 #define AM2301 21
 
+// Results from DHT::poll()
+#define DHT_BUSY  0
+#define DHT_OK    1
+#define DHT_ERROR 2
+
+// Falling edges in a frame: the sensor's response, one at the start of each
+// of the 40 bits, and the end of the last bit.
+#define DHT_EDGES 42
+
 
 class DHT {
   public:
@@ -46,6 +55,16 @@ class DHT {
    float readHumidity(bool force=false);
    boolean read(bool force=false);
 
+   // Non-blocking read.  startRead() begins a conversion and returns right
+   // away; call poll() until it returns DHT_OK or DHT_ERROR, then use
+   // readTemperature()/readHumidity() as usual to get the cached result.
+   // Bits are decoded from falling edge timestamps taken in a pin change
+   // interrupt, so interrupts are never masked.  The pin must support
+   // attachInterrupt(), and only one conversion can run at a time.
+   boolean startRead(void);
+   uint8_t poll(void);
+   void onRead(void (*callback)(DHT &dht, boolean success));
+
  private:
   uint8_t data[5];
   uint8_t _pin, _type;
@@ -59,6 +78,16 @@ class DHT {
 
   uint32_t expectPulse(bool level);
 
+  uint8_t _asyncState;
+  uint32_t _asyncStart;
+  void (*_callback)(DHT &dht, boolean success);
+  uint8_t finishRead(boolean success);
+
+  static DHT *_active;
+  static volatile uint8_t _edgeCount;
+  static volatile uint32_t _edges[DHT_EDGES];
+  static void edgeInterrupt(void);
+
 };
 
 class InterruptLock {
@@ -0,0 +1,47 @@
+// Non-blocking read of a DHT sensor: start a conversion, keep doing other
+// work and pick up the result when poll() says it's ready.
+// Public domain
+
+#include "DHT.h"
+
+#define DHTPIN 2     // must be a pin that supports attachInterrupt()
+#define DHTTYPE DHT22   // DHT 22  (AM2302), AM2321
+
+DHT dht(DHTPIN, DHTTYPE);
+
+uint32_t loops = 0;
+
+void setup() {
+  Serial.begin(9600);
+  Serial.println("DHTxx async test!");
+
+  dht.begin();
+  dht.startRead();
+}
+
+void loop() {
+  loops++;
+
+  uint8_t result = dht.poll();
+  if (result == DHT_BUSY) {
+    return;
+  }
+
+  if (result == DHT_OK) {
+    Serial.print("Humidity: ");
+    Serial.print(dht.readHumidity());
+    Serial.print(" %\t");
+    Serial.print("Temperature: ");
+    Serial.print(dht.readTemperature());
+    Serial.print(" *C\t");
+  } else {
+    Serial.print("Failed to read from DHT sensor!\t");
+  }
+
+  Serial.print("loops while reading: ");
+  Serial.println(loops);
+  loops = 0;
+
+  delay(2000);
+  dht.startRead();
+}
@@ -425,6 +425,119 @@ void RTC_PCF8523::writeSqwPinMode(Pcf8523SqwPinMode mode) {
   Wire.endTransmission();
 }
 
+// Control_2 flag bits are cleared by writing 0 and left alone by writing 1,
+// so clear one flag by writing back every other flag as 1.
+#define PCF8523_CONTROL_2_FLAGS 0xF8 // WTAF, CTAF, CTBF, SF, AF
+#define PCF8523_CTAF  0x40
+#define PCF8523_SF    0x10
+#define PCF8523_AF    0x08
+#define PCF8523_CTAIE 0x02
+#define PCF8523_SIE   0x04 // in Control_1
+#define PCF8523_AIE   0x02 // in Control_1
+
+static void pcf8523_clear_flag(uint8_t flag) {
+  uint8_t ctrl = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2, (ctrl | PCF8523_CONTROL_2_FLAGS) & ~flag);
+}
+
+static void pcf8523_disable_clkout(void) {
+  // COF = 111 turns CLKOUT off so the pin can act as INT1
+  uint8_t ctrl = read_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL, ctrl | 0x38);
+}
+
+void RTC_PCF8523::enableCountdownTimer(Pcf8523TimerClockFreq clkFreq, uint8_t numPeriods) {
+  disableCountdownTimer();
+  pcf8523_disable_clkout();
+
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_TIMER_A_FRCTL, clkFreq);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_TIMER_A_VALUE, numPeriods);
+
+  // interrupt stays asserted until the flag is cleared (TAM = 0)
+  uint8_t ctrl2 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2, ((ctrl2 | PCF8523_CONTROL_2_FLAGS) & ~PCF8523_CTAF) | PCF8523_CTAIE);
+
+  // TAC = 01, countdown mode, starts the timer
+  uint8_t clkout = read_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL, (clkout & ~0x86) | 0x02);
+}
+
+void RTC_PCF8523::disableCountdownTimer(void) {
+  uint8_t clkout = read_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CLKOUTCONTROL, clkout & ~0x06);
+
+  uint8_t ctrl2 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2, ((ctrl2 | PCF8523_CONTROL_2_FLAGS) & ~PCF8523_CTAF) & ~PCF8523_CTAIE);
+}
+
+boolean RTC_PCF8523::countdownTimerFired(void) {
+  return (read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2) & PCF8523_CTAF) != 0;
+}
+
+void RTC_PCF8523::clearCountdownTimer(void) {
+  pcf8523_clear_flag(PCF8523_CTAF);
+}
+
+void RTC_PCF8523::enableAlarm(const DateTime& dt) {
+  pcf8523_disable_clkout();
+
+  // AEN_x = 0 enables matching on that field; the weekday alarm is left off
+  Wire.beginTransmission(PCF8523_ADDRESS);
+  Wire._I2C_WRITE((byte)PCF8523_ALARM_MINUTE);
+  Wire._I2C_WRITE(bin2bcd(dt.minute()));
+  Wire._I2C_WRITE(bin2bcd(dt.hour()));
+  Wire._I2C_WRITE(bin2bcd(dt.day()));
+  Wire._I2C_WRITE((byte)0x80);
+  Wire.endTransmission();
+
+  clearAlarm();
+
+  uint8_t ctrl1 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_1);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_1, ctrl1 | PCF8523_AIE);
+}
+
+void RTC_PCF8523::disableAlarm(void) {
+  uint8_t ctrl1 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_1);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_1, ctrl1 & ~PCF8523_AIE);
+
+  Wire.beginTransmission(PCF8523_ADDRESS);
+  Wire._I2C_WRITE((byte)PCF8523_ALARM_MINUTE);
+  for (uint8_t i = 0; i < 4; i++) Wire._I2C_WRITE((byte)0x80);
+  Wire.endTransmission();
+
+  clearAlarm();
+}
+
+boolean RTC_PCF8523::alarmFired(void) {
+  return (read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2) & PCF8523_AF) != 0;
+}
+
+void RTC_PCF8523::clearAlarm(void) {
+  pcf8523_clear_flag(PCF8523_AF);
+}
+
+void RTC_PCF8523::enableSecondTimer(void) {
+  pcf8523_disable_clkout();
+
+  uint8_t ctrl1 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_1);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_1, ctrl1 | PCF8523_SIE);
+}
+
+void RTC_PCF8523::disableSecondTimer(void) {
+  uint8_t ctrl1 = read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_1);
+  write_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_1, ctrl1 & ~PCF8523_SIE);
+
+  clearSecondTimer();
+}
+
+boolean RTC_PCF8523::secondTimerFired(void) {
+  return (read_i2c_register(PCF8523_ADDRESS, PCF8523_CONTROL_2) & PCF8523_SF) != 0;
+}
+
+void RTC_PCF8523::clearSecondTimer(void) {
+  pcf8523_clear_flag(PCF8523_SF);
+}
+
 
 
 
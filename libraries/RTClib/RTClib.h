@@ -10,7 +10,12 @@ class TimeSpan;
 
 #define PCF8523_ADDRESS       0x68
 #define PCF8523_CLKOUTCONTROL 0x0F
+#define PCF8523_CONTROL_1     0x00
+#define PCF8523_CONTROL_2     0x01
 #define PCF8523_CONTROL_3     0x02
+#define PCF8523_ALARM_MINUTE  0x0A
+#define PCF8523_TIMER_A_FRCTL 0x10
+#define PCF8523_TIMER_A_VALUE 0x11
 
 #define DS1307_ADDRESS  0x68
 #define DS1307_CONTROL  0x07
@@ -109,6 +114,10 @@ public:
 // RTC based on the PCF8523 chip connected via I2C and the Wire library
 enum Pcf8523SqwPinMode { PCF8523_OFF = 7, PCF8523_SquareWave1HZ = 6, PCF8523_SquareWave32HZ = 5, PCF8523_SquareWave1kHz = 4, PCF8523_SquareWave4kHz = 3, PCF8523_SquareWave8kHz = 2, PCF8523_SquareWave16kHz = 1, PCF8523_SquareWave32kHz = 0 };
 
+// Source clock for the countdown timer; one period of the timer lasts one
+// cycle of this clock.
+enum Pcf8523TimerClockFreq { PCF8523_Frequency4kHz = 0, PCF8523_Frequency64Hz = 1, PCF8523_FrequencySecond = 2, PCF8523_FrequencyMinute = 3, PCF8523_FrequencyHour = 4 };
+
 class RTC_PCF8523 {
 public:
     boolean begin(void);
@@ -118,6 +127,25 @@ public:
 
     Pcf8523SqwPinMode readSqwPinMode();
     void writeSqwPinMode(Pcf8523SqwPinMode mode);
+
+    // The countdown timer, alarm and second interrupt all drive the INT1
+    // pin low while their flag is set.  INT1 shares a pin with the square
+    // wave output, so enabling any of them turns the square wave off.
+    void enableCountdownTimer(Pcf8523TimerClockFreq clkFreq, uint8_t numPeriods);
+    void disableCountdownTimer(void);
+    boolean countdownTimerFired(void);
+    void clearCountdownTimer(void);
+
+    // Fires when the minute, hour and day of the month all match.
+    void enableAlarm(const DateTime& dt);
+    void disableAlarm(void);
+    boolean alarmFired(void);
+    void clearAlarm(void);
+
+    void enableSecondTimer(void);
+    void disableSecondTimer(void);
+    boolean secondTimerFired(void);
+    void clearSecondTimer(void);
 };
 
 // RTC using the internal millis() clock, has to be initialized before use
@@ -0,0 +1,57 @@
+// Countdown timer and alarm interrupts on a PCF8523 RTC connected via I2C
+// and Wire lib.  Connect the RTC's INT pin to INTERRUPT_PIN; the pin is
+// pulled low by the RTC until the interrupt flag is cleared.
+#include <Wire.h>
+#include "RTClib.h"
+
+#define INTERRUPT_PIN 5
+
+RTC_PCF8523 rtc;
+
+volatile bool interrupted = false;
+
+void rtc_interrupt() {
+  interrupted = true;
+}
+
+void setup () {
+
+  while (!Serial) {
+    delay(1);  // for Leonardo/Micro/Zero
+  }
+
+  Serial.begin(57600);
+  if (! rtc.begin()) {
+    Serial.println("Couldn't find RTC");
+    while (1);
+  }
+
+  pinMode(INTERRUPT_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(INTERRUPT_PIN), rtc_interrupt, FALLING);
+
+  // fire every 10 seconds
+  rtc.enableCountdownTimer(PCF8523_FrequencySecond, 10);
+
+  // and once, two minutes from now
+  rtc.enableAlarm(rtc.now() + TimeSpan(0, 0, 2, 0));
+}
+
+void loop () {
+  if (interrupted) {
+    interrupted = false;
+
+    Serial.print(rtc.now().unixtime());
+
+    if (rtc.countdownTimerFired()) {
+      Serial.print(" countdown timer");
+      rtc.clearCountdownTimer();
+    }
+
+    if (rtc.alarmFired()) {
+      Serial.print(" alarm");
+      rtc.disableAlarm();
+    }
+
+    Serial.println();
+  }
+}
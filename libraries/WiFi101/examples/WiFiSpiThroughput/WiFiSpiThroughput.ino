@@ -0,0 +1,74 @@
+/*
+ * This example measures the SPI throughput between the board and the
+ * WINC1500 by repeatedly reading a block of the module's shared memory,
+ * first with the byte by byte transfer loop and then with DMA.
+ *
+ * Circuit:
+ * - WiFi101 Shield attached, or a board with a WINC1500 on board
+ *
+ * This code is in the public domain.
+ */
+#include <SPI.h>
+#include <WiFi101.h>
+#include <driver/source/nmbus.h>
+#include <bus_wrapper/include/nm_bus_wrapper.h>
+
+#define SHARED_MEM_BASE  0xd0000
+#define BLOCK_SIZE       1024
+#define ITERATIONS       256
+
+uint8_t buffer[BLOCK_SIZE];
+
+void setup() {
+  // WiFi.setPins(8, 7, 4, 2);  // Adafruit Feather M0 WiFi
+
+  // Initialize serial
+  Serial.begin(9600);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+
+  Serial.println("WiFi101 SPI throughput.");
+  Serial.println();
+
+  // Check for the presence of the shield, this also initializes the bus
+  if (WiFi.status() == WL_NO_SHIELD) {
+    Serial.println("WiFi shield not present");
+    while (true);
+  }
+
+  nm_bus_dma_enable(0);
+  printThroughput("byte loop: ");
+
+  if (nm_bus_dma_enable(1) == M2M_SUCCESS) {
+    printThroughput("DMA:       ");
+  } else {
+    Serial.println("DMA:       not available on this board");
+  }
+}
+
+void loop() {
+}
+
+void printThroughput(const char *label) {
+  unsigned long start = micros();
+
+  for (int i = 0; i < ITERATIONS; i++) {
+    if (nm_read_block(SHARED_MEM_BASE, buffer, sizeof(buffer)) != M2M_SUCCESS) {
+      Serial.print(label);
+      Serial.println("read failed");
+      return;
+    }
+  }
+
+  unsigned long elapsed = micros() - start;
+  unsigned long bytes = (unsigned long)ITERATIONS * sizeof(buffer);
+
+  Serial.print(label);
+  Serial.print(bytes);
+  Serial.print(" bytes in ");
+  Serial.print(elapsed);
+  Serial.print(" us, ");
+  Serial.print((unsigned long)(bytes * 1000000.0 / elapsed));
+  Serial.println(" bytes/s");
+}
@@ -62,6 +62,9 @@ static void wifi_cb(uint8_t u8MsgType, void *pvMsg)
 			tstrM2mWifiStateChanged *pstrWifiState = (tstrM2mWifiStateChanged *)pvMsg;
 			if (pstrWifiState->u8CurrState == M2M_WIFI_CONNECTED) {
 				//SERIAL_PORT_MONITOR.println("wifi_cb: M2M_WIFI_RESP_CON_STATE_CHANGED: CONNECTED");
+				if (WiFi._mode == WL_STA_MODE) {
+					WiFi._associated = true;
+				}
 				if (WiFi._mode == WL_STA_MODE && !WiFi._dhcp) {
 					WiFi._status = WL_CONNECTED;
 
@@ -74,10 +77,13 @@ static void wifi_cb(uint8_t u8MsgType, void *pvMsg)
 				//SERIAL_PORT_MONITOR.println("wifi_cb: M2M_WIFI_RESP_CON_STATE_CHANGED: DISCONNECTED");
 				if (WiFi._mode == WL_STA_MODE) {
 					WiFi._status = WL_DISCONNECTED;
+					WiFi._associated = false;
 					if (WiFi._dhcp) {
 						WiFi._localip = 0;
 						WiFi._submask = 0;
 						WiFi._gateway = 0;
+						WiFi._dnsserver = 0;
+						WiFi._leasetime = 0;
 					}
 					// Close sockets to clean state
 					// Clients will need to reconnect once the physical link will be re-established
@@ -102,6 +108,8 @@ static void wifi_cb(uint8_t u8MsgType, void *pvMsg)
 				WiFi._localip = pstrIPCfg->u32StaticIP;
 				WiFi._submask = pstrIPCfg->u32SubnetMask;
 				WiFi._gateway = pstrIPCfg->u32Gateway;
+				WiFi._dnsserver = pstrIPCfg->u32DNS;
+				WiFi._leasetime = pstrIPCfg->u32DhcpLeaseTime;
 				
 				WiFi._status = WL_CONNECTED;
 
@@ -240,6 +248,14 @@ WiFiClass::WiFiClass()
 	_mode = WL_RESET_MODE;
 	_status = WL_NO_SHIELD;
 	_init = 0;
+	_timeout = 60000;
+	_resolveHost[0] = '\0';
+	_resolveStart = 0;
+}
+
+void WiFiClass::setTimeout(unsigned long timeout)
+{
+	_timeout = timeout;
 }
 
 void WiFiClass::setPins(int8_t cs, int8_t irq, int8_t rst, int8_t en)
@@ -277,6 +293,9 @@ int WiFiClass::init()
 	_localip = 0;
 	_submask = 0;
 	_gateway = 0;
+	_dnsserver = 0;
+	_leasetime = 0;
+	_associated = false;
 	_dhcp = 1;
 	_resolve = 0;
 	_remoteMacAddress = 0;
@@ -345,6 +364,7 @@ uint8_t WiFiClass::begin()
 		return _status;
 	}
 	_status = WL_IDLE_STATUS;
+	_associated = false;
 	_mode = WL_STA_MODE;
 
 	// Wait for connection or timeout:
@@ -400,6 +420,8 @@ uint8_t WiFiClass::startConnect(const char *ssid, uint8_t u8SecType, const void
 		_localip = 0;
 		_submask = 0;
 		_gateway = 0;
+		_dnsserver = 0;
+		_leasetime = 0;
 	}
 	if (m2m_wifi_connect((char*)ssid, strlen(ssid), u8SecType, (void*)pvAuthInfo, M2M_WIFI_CH_ALL) < 0) {
 		_status = WL_CONNECT_FAILED;
@@ -409,14 +431,16 @@ uint8_t WiFiClass::startConnect(const char *ssid, uint8_t u8SecType, const void
 	_mode = WL_STA_MODE;
 
 	// Wait for connection or timeout:
-	unsigned long start = millis();
-	while (!(_status & WL_CONNECTED) &&
-			!(_status & WL_DISCONNECTED) &&
-			millis() - start < 60000) {
-		m2m_wifi_handle_events(NULL);
-	}
-	if (!(_status & WL_CONNECTED)) {
-		_mode = WL_RESET_MODE;
+	if (_timeout) {
+		unsigned long start = millis();
+		while (!(_status & WL_CONNECTED) &&
+				!(_status & WL_DISCONNECTED) &&
+				millis() - start < _timeout) {
+			m2m_wifi_handle_events(NULL);
+		}
+		if (!(_status & WL_CONNECTED)) {
+			_mode = WL_RESET_MODE;
+		}
 	}
 
 	memset(_ssid, 0, M2M_MAX_SSID_LEN);
@@ -638,6 +662,8 @@ void WiFiClass::config(IPAddress local_ip, IPAddress dns_server, IPAddress gatew
 	_localip = conf.u32StaticIP;
 	_submask = conf.u32SubnetMask;
 	_gateway = conf.u32Gateway;
+	_dnsserver = conf.u32DNS;
+	_leasetime = 0;
 }
 
 void WiFiClass::hostname(const char* name)
@@ -713,6 +739,16 @@ uint32_t WiFiClass::gatewayIP()
 	return _gateway;
 }
 
+uint32_t WiFiClass::dnsIP()
+{
+	return _dnsserver;
+}
+
+uint32_t WiFiClass::dhcpLeaseTime()
+{
+	return _leasetime;
+}
+
 char* WiFiClass::SSID()
 {
 	if (_status == WL_CONNECTED || _status == WL_AP_LISTENING || _status == WL_AP_CONNECTED) {
@@ -948,14 +984,30 @@ uint8_t WiFiClass::status()
 	return _status;
 }
 
+bool WiFiClass::associated()
+{
+	if (!_init) {
+		init();
+	}
+
+	m2m_wifi_handle_events(NULL);
+
+	return _associated;
+}
+
 int WiFiClass::hostByName(const char* aHostname, IPAddress& aResult)
 {
-	
+	uint32_t cached;
+
 	// check if aHostname is already an ipaddress
 	if (aResult.fromString(aHostname)) {
 		// if fromString returns true we have an IP address ready 
 		return 1;
 
+	} else if (_dnsCache.lookup(aHostname, cached)) {
+		aResult = cached;
+		return 1;
+
 	} else {
 		// Network led ON (rev A then rev B).
 		m2m_periph_gpio_set_val(M2M_PERIPH_GPIO16, 0);
@@ -981,15 +1033,82 @@ int WiFiClass::hostByName(const char* aHostname, IPAddress& aResult)
 		m2m_periph_gpio_set_val(M2M_PERIPH_GPIO5, 1);
 
 		if (_resolve == 0) {
+			// DNS is down, use the address it gave last time
+			if (_dnsCache.lastKnownGood(aHostname, cached)) {
+				aResult = cached;
+				return 1;
+			}
 			return 0;
 		}
 
+		_dnsCache.store(aHostname, _resolve);
 		aResult = _resolve;
 		_resolve = 0;
 		return 1;
 	}
 }
 
+int WiFiClass::beginHostByName(const char* aHostname)
+{
+	IPAddress ip;
+	uint32_t cached;
+
+	_resolveHost[0] = '\0';
+
+	// check if aHostname is already an ipaddress
+	if (ip.fromString(aHostname)) {
+		_resolve = ip;
+		return 1;
+	}
+
+	if (_dnsCache.lookup(aHostname, cached)) {
+		_resolve = cached;
+		return 1;
+	}
+
+	_resolve = 0;
+	if (gethostbyname((uint8 *)aHostname) < 0) {
+		return 0;
+	}
+
+	// names too long for the cache are resolved but not cached
+	if (strlen(aHostname) < DNS_CACHE_HOSTNAME_LEN) {
+		strcpy(_resolveHost, aHostname);
+	}
+	_resolveStart = millis();
+	return 1;
+}
+
+int WiFiClass::hostByNameResult(IPAddress& aResult)
+{
+	uint32_t cached;
+
+	m2m_wifi_handle_events(NULL);
+
+	if (_resolve == 0) {
+		if (millis() - _resolveStart < 20000) {
+			return 0;
+		}
+
+		// DNS is down, use the address it gave last time
+		if (_resolveHost[0] && _dnsCache.lastKnownGood(_resolveHost, cached)) {
+			_resolveHost[0] = '\0';
+			aResult = cached;
+			return 1;
+		}
+		return -1;
+	}
+
+	if (_resolveHost[0]) {
+		_dnsCache.store(_resolveHost, _resolve);
+		_resolveHost[0] = '\0';
+	}
+
+	aResult = _resolve;
+	_resolve = 0;
+	return 1;
+}
+
 void WiFiClass::refresh(void)
 {
 	// Update state machine:
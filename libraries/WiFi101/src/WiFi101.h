@@ -34,6 +34,7 @@ extern "C" {
 }
 
 #include "WiFiClient.h"
+#include "WiFiDnsCache.h"
 #include "WiFiSSLClient.h"
 #include "WiFiServer.h"
 
@@ -83,6 +84,9 @@ public:
 	uint32_t _localip;
 	uint32_t _submask;
 	uint32_t _gateway;
+	uint32_t _dnsserver;
+	uint32_t _leasetime;
+	bool _associated;
 	int _dhcp;
 	uint32_t _resolve;
 	byte *_remoteMacAddress;
@@ -115,6 +119,12 @@ public:
 	uint8_t begin(const String &ssid, uint8_t key_idx, const String &key) { return begin(ssid.c_str(), key_idx, key.c_str()); }
 	uint8_t begin(const String &ssid, const String &key) { return begin(ssid.c_str(), key.c_str()); }
 
+	/* Set how long begin() waits for the connection, in milliseconds.
+	 * With a timeout of 0 begin() returns as soon as the connection has
+	 * been requested and status() reports the result.
+	 */
+	void setTimeout(unsigned long timeout);
+
 	/* Start Wifi in Access Point, with open security.
 	 * Only one client can connect to the AP at a time.
 	 *
@@ -148,6 +158,8 @@ public:
 	uint32_t localIP();
 	uint32_t subnetMask();
 	uint32_t gatewayIP();
+	uint32_t dnsIP();
+	uint32_t dhcpLeaseTime();
 	char* SSID();
 	int32_t RSSI();
 	uint8_t encryptionType();
@@ -162,9 +174,32 @@ public:
 
 	uint8_t status();
 
+	/* Whether the station has joined its access point.  Unlike status(),
+	 * this is true while DHCP is still running.
+	 */
+	bool associated();
+
 	int hostByName(const char* hostname, IPAddress& result);
 	int hostByName(const String &hostname, IPAddress& result) { return hostByName(hostname.c_str(), result); }
 
+	/* Resolve a hostname without waiting for the reply.
+	 * beginHostByName() returns 1 if the request was sent, then
+	 * hostByNameResult() returns 1 and fills in result once it resolves,
+	 * or -1 if the lookup timed out with no cached address to fall back on.
+	 */
+	int beginHostByName(const char* hostname);
+	int hostByNameResult(IPAddress& result);
+
+	/* Resolved hostnames are cached for ttl seconds, as measured by clock.
+	 * See WiFiDnsCache.h.
+	 */
+	void setDnsCacheTtl(uint32_t ttl) { _dnsCache.setTtl(ttl); }
+	void setDnsCacheClock(uint32_t (*clock)(void)) { _dnsCache.setClock(clock); }
+	void flushDnsCache() { _dnsCache.flush(); }
+	uint32_t dnsCacheHits() { return _dnsCache.hits(); }
+	uint32_t dnsCacheMisses() { return _dnsCache.misses(); }
+	uint32_t dnsCacheFallbacks() { return _dnsCache.fallbacks(); }
+
 	int ping(const char* hostname, uint8_t ttl = 128);
 	int ping(const String &hostname, uint8_t ttl = 128);
 	int ping(IPAddress host, uint8_t ttl = 128);
@@ -180,6 +215,10 @@ public:
 private:
 	int _init;
 	char _version[9];
+	unsigned long _timeout;
+	WiFiDnsCache _dnsCache;
+	char _resolveHost[DNS_CACHE_HOSTNAME_LEN];
+	unsigned long _resolveStart;
 
 	uint8_t startConnect(const char *ssid, uint8_t u8SecType, const void *pvAuthInfo);
 	uint8_t startAP(const char *ssid, uint8_t u8SecType, const void *pvAuthInfo, uint8_t channel);
@@ -122,7 +122,12 @@ int WiFiClient::connect(const char* host, uint16_t port, uint8_t opt)
 	return 0;
 }
 
-int WiFiClient::connect(IPAddress ip, uint16_t port, uint8_t opt, const uint8_t *hostname)
+int WiFiClient::connectNoWait(IPAddress ip, uint16_t port)
+{
+	return connect(ip, port, 0, NULL, false);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, uint8_t opt, const uint8_t *hostname, bool wait)
 {
 	struct sockaddr_in addr;
 
@@ -153,6 +158,11 @@ int WiFiClient::connect(IPAddress ip, uint16_t port, uint8_t opt, const uint8_t
 		return 0;
 	}
 
+	if (!wait) {
+		WiFi._client[_socket] = this;
+		return 1;
+	}
+
 	// Wait for connection or timeout:
 	unsigned long start = millis();
 	while (!IS_CONNECTED && millis() - start < 20000) {
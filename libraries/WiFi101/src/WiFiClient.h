@@ -38,6 +38,9 @@ public:
 	int connectSSL(const char* host, uint16_t port);
 	virtual int connect(IPAddress ip, uint16_t port);
 	virtual int connect(const char* host, uint16_t port);
+	/* Start connecting and return without waiting; connected() reports
+	 * when the connection is up. */
+	int connectNoWait(IPAddress ip, uint16_t port);
 	virtual size_t write(uint8_t);
 	virtual size_t write(const uint8_t *buf, size_t size);
 	virtual int available();
@@ -60,7 +63,7 @@ private:
 	uint32_t _tail;
 	uint8_t	_buffer[SOCKET_BUFFER_TCP_SIZE];
 	int connect(const char* host, uint16_t port, uint8_t opt);
-	int connect(IPAddress ip, uint16_t port, uint8_t opt, const uint8_t *hostname);
+	int connect(IPAddress ip, uint16_t port, uint8_t opt, const uint8_t *hostname, bool wait = true);
 	void copyFrom(const WiFiClient& other);
 
 };
@@ -0,0 +1,184 @@
+/*
+  WiFiDnsCache - hostname cache for WiFi101.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stddef.h>
+
+#include "WiFiDnsCache.h"
+
+#define DNS_CACHE_MAGIC 0x444e5331 // "DNS1"
+
+typedef struct {
+	char hostname[DNS_CACHE_HOSTNAME_LEN];
+	uint32_t ip;
+	uint32_t expires;
+} dns_cache_entry;
+
+typedef struct {
+	uint32_t magic;
+	dns_cache_entry entries[DNS_CACHE_SIZE];
+	uint32_t next;
+	uint32_t checksum;
+} dns_cache_table;
+
+#ifdef ARDUINO_ARCH_SAMD
+static dns_cache_table table __attribute__((section(".noinit")));
+#else
+static dns_cache_table table;
+#endif
+
+static uint32_t table_checksum()
+{
+	const uint8_t *data = (const uint8_t *)&table;
+	uint32_t hash = 2166136261UL;
+
+	for (size_t i = 0; i < offsetof(dns_cache_table, checksum); i++) {
+		hash = (hash ^ data[i]) * 16777619UL;
+	}
+
+	return hash;
+}
+
+static uint32_t millis_seconds(void)
+{
+	return millis() / 1000;
+}
+
+WiFiDnsCache::WiFiDnsCache()
+{
+	_ttl = DNS_CACHE_DEFAULT_TTL;
+	_clock = millis_seconds;
+	_loaded = false;
+	_hits = 0;
+	_misses = 0;
+	_fallbacks = 0;
+}
+
+void WiFiDnsCache::setTtl(uint32_t seconds)
+{
+	_ttl = seconds;
+}
+
+void WiFiDnsCache::setClock(uint32_t (*clock)(void))
+{
+	_clock = clock ? clock : millis_seconds;
+}
+
+uint32_t WiFiDnsCache::now()
+{
+	return _clock();
+}
+
+// Check the table the first time it's used after a reset.
+void WiFiDnsCache::load()
+{
+	if (_loaded) {
+		return;
+	}
+	_loaded = true;
+
+	if (table.magic != DNS_CACHE_MAGIC || table.checksum != table_checksum()) {
+		memset(&table, 0, sizeof(table));
+		table.magic = DNS_CACHE_MAGIC;
+		save();
+		return;
+	}
+
+	// millis() restarted with the reset, so the old expiry times mean nothing
+	if (_clock == millis_seconds) {
+		flush();
+	}
+}
+
+void WiFiDnsCache::save()
+{
+	table.checksum = table_checksum();
+}
+
+int WiFiDnsCache::find(const char* hostname)
+{
+	for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+		if (table.entries[i].ip && strncmp(table.entries[i].hostname, hostname, DNS_CACHE_HOSTNAME_LEN) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// Returns true with the cached address if hostname has an unexpired entry.
+bool WiFiDnsCache::lookup(const char* hostname, uint32_t& ip)
+{
+	load();
+
+	int i = find(hostname);
+	if (i >= 0 && (int32_t)(table.entries[i].expires - now()) > 0) {
+		ip = table.entries[i].ip;
+		_hits++;
+		return true;
+	}
+
+	_misses++;
+	return false;
+}
+
+// Returns true with the last address hostname resolved to, expired or not.
+bool WiFiDnsCache::lastKnownGood(const char* hostname, uint32_t& ip)
+{
+	load();
+
+	int i = find(hostname);
+	if (i < 0) {
+		return false;
+	}
+
+	ip = table.entries[i].ip;
+	_fallbacks++;
+	return true;
+}
+
+void WiFiDnsCache::store(const char* hostname, uint32_t ip)
+{
+	load();
+
+	if (ip == 0 || strlen(hostname) >= DNS_CACHE_HOSTNAME_LEN) {
+		return;
+	}
+
+	int i = find(hostname);
+	if (i < 0) {
+		i = table.next;
+		table.next = (table.next + 1) % DNS_CACHE_SIZE;
+	}
+
+	strncpy(table.entries[i].hostname, hostname, DNS_CACHE_HOSTNAME_LEN);
+	table.entries[i].ip = ip;
+	table.entries[i].expires = now() + _ttl;
+	save();
+}
+
+// Expire every entry, keeping the addresses as last known good.
+void WiFiDnsCache::flush()
+{
+	load();
+
+	uint32_t expired = now();
+	for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+		table.entries[i].expires = expired;
+	}
+	save();
+}
@@ -0,0 +1,68 @@
+/*
+  WiFiDnsCache - hostname cache for WiFi101.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WIFIDNSCACHE_H
+#define WIFIDNSCACHE_H
+
+#include <Arduino.h>
+
+#define DNS_CACHE_SIZE           4
+#define DNS_CACHE_HOSTNAME_LEN   64
+#define DNS_CACHE_DEFAULT_TTL    3600  // seconds
+
+/*
+ * Remembers the addresses hostByName() resolves.  The WINC1500 does not
+ * report record TTLs, so every entry lives for the same configurable time.
+ * Expired entries are kept as the last known good address, for use when
+ * the DNS server does not answer.
+ *
+ * On SAMD boards the entries are kept in RAM that survives a warm reset.
+ * Expiry times are measured with the clock given to setClock(); with the
+ * default clock, millis(), entries restored after a reset count as expired.
+ */
+class WiFiDnsCache {
+public:
+	WiFiDnsCache();
+
+	void setTtl(uint32_t seconds);
+	void setClock(uint32_t (*clock)(void));
+
+	bool lookup(const char* hostname, uint32_t& ip);
+	bool lastKnownGood(const char* hostname, uint32_t& ip);
+	void store(const char* hostname, uint32_t ip);
+	void flush();
+
+	uint32_t hits() { return _hits; }
+	uint32_t misses() { return _misses; }
+	uint32_t fallbacks() { return _fallbacks; }
+
+private:
+	uint32_t now();
+	void load();
+	void save();
+	int find(const char* hostname);
+
+	uint32_t _ttl;
+	uint32_t (*_clock)(void);
+	bool _loaded;
+	uint32_t _hits;
+	uint32_t _misses;
+	uint32_t _fallbacks;
+};
+
+#endif /* WIFIDNSCACHE_H */
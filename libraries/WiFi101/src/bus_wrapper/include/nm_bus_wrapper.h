@@ -163,6 +163,14 @@ sint8 nm_bus_deinit(void);
 */
 sint8 nm_bus_reinit(void *);
 /*
+*	@fn			nm_bus_dma_enable
+*	@brief		enable or disable DMA for bulk SPI transfers
+*	@param [in]	uint8 u8Enable
+*					non-zero to use DMA when it is available
+*	@return		ZERO if DMA will be used and M2M_ERR_BUS_FAIL if it is unavailable or disabled
+*/
+sint8 nm_bus_dma_enable(uint8 u8Enable);
+/*
 *	@fn			nm_bus_get_chip_type
 *	@brief		get chip type
 *	@return		ZERO in case of success and M2M_ERR_BUS_FAIL in case of failure
@@ -72,11 +72,149 @@ tstrNmBusCapabilities egstrNmBusCapabilities =
 
 static const SPISettings wifi_SPISettings(12000000L, MSBFIRST, SPI_MODE0);
 
+#if defined(ARDUINO_ARCH_SAMD)
+/*
+ * Bulk transfers are moved by two DMAC channels, one feeding the SERCOM
+ * DATA register and one draining it, so a block runs at the SPI clock
+ * instead of at the speed of a per byte transfer() loop.
+ *
+ * Variants that put WINC1501_SPI on another SERCOM must define these too.
+ */
+#if !defined(WINC1501_SPI_SERCOM)
+  #define WINC1501_SPI_SERCOM			SERCOM4
+  #define WINC1501_SPI_DMAC_ID_TX		SERCOM4_DMAC_ID_TX
+  #define WINC1501_SPI_DMAC_ID_RX		SERCOM4_DMAC_ID_RX
+#endif
+
+#define NM_BUS_DMA_MIN_SZ	16	/* below this the channel setup costs more than it saves */
+#define NM_BUS_DMA_TX_CH	0
+#define NM_BUS_DMA_RX_CH	1
+
+static DmacDescriptor gstrDmaDescriptor[2] __attribute__((aligned(16)));
+static DmacDescriptor gstrDmaWriteback[2] __attribute__((aligned(16)));
+static const uint8 gu8DmaZero = 0;
+static uint8 gu8DmaSink;
+static uint8 gu8DmaReady = 0;
+static uint8 gu8DmaEnabled = 1;
+
+static void dma_channel_init(uint8 u8Channel, uint8 u8Trigger)
+{
+	DMAC->CHID.reg = DMAC_CHID_ID(u8Channel);
+	DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+	while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST);
+	DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(0) |
+						DMAC_CHCTRLB_TRIGSRC(u8Trigger) |
+						DMAC_CHCTRLB_TRIGACT_BEAT;
+}
+
+/*
+ * The DMAC has a single descriptor base address, so only take it over if
+ * nothing else in the sketch has enabled it already.
+ */
+static void dma_init(void)
+{
+	if (gu8DmaReady)
+		return;
+
+	PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+	PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+
+	if (DMAC->CTRL.reg & DMAC_CTRL_DMAENABLE)
+		return;
+
+	DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+	while (DMAC->CTRL.reg & DMAC_CTRL_SWRST);
+
+	memset(gstrDmaDescriptor, 0, sizeof(gstrDmaDescriptor));
+	memset(gstrDmaWriteback, 0, sizeof(gstrDmaWriteback));
+	DMAC->BASEADDR.reg = (uint32_t)gstrDmaDescriptor;
+	DMAC->WRBADDR.reg = (uint32_t)gstrDmaWriteback;
+	DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xf);
+
+	dma_channel_init(NM_BUS_DMA_TX_CH, WINC1501_SPI_DMAC_ID_TX);
+	dma_channel_init(NM_BUS_DMA_RX_CH, WINC1501_SPI_DMAC_ID_RX);
+
+	gu8DmaReady = 1;
+}
+
+/*
+ * Must be called with the SPI transaction open and CS asserted.
+ * Either pu8Mosi or pu8Miso may be NULL, as for spi_rw().
+ */
+static sint8 dma_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
+{
+	volatile void *pvData = &WINC1501_SPI_SERCOM->SPI.DATA.reg;
+	DmacDescriptor *pstrTx = &gstrDmaDescriptor[NM_BUS_DMA_TX_CH];
+	DmacDescriptor *pstrRx = &gstrDmaDescriptor[NM_BUS_DMA_RX_CH];
+	uint8 u8Flags;
+
+	/* Source and destination addresses point one past the end when incrementing. */
+	pstrTx->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE |
+						 (pu8Mosi ? DMAC_BTCTRL_SRCINC : 0);
+	pstrTx->BTCNT.reg = u16Sz;
+	pstrTx->SRCADDR.reg = pu8Mosi ? (uint32_t)(pu8Mosi + u16Sz) : (uint32_t)&gu8DmaZero;
+	pstrTx->DSTADDR.reg = (uint32_t)pvData;
+	pstrTx->DESCADDR.reg = 0;
+
+	pstrRx->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE |
+						 (pu8Miso ? DMAC_BTCTRL_DSTINC : 0);
+	pstrRx->BTCNT.reg = u16Sz;
+	pstrRx->SRCADDR.reg = (uint32_t)pvData;
+	pstrRx->DSTADDR.reg = pu8Miso ? (uint32_t)(pu8Miso + u16Sz) : (uint32_t)&gu8DmaSink;
+	pstrRx->DESCADDR.reg = 0;
+
+	/* Start the receiver first so that no byte is missed. */
+	DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_RX_CH);
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+	DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_TX_CH);
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+	DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+
+	/* The last byte received is also the end of the transfer. */
+	DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_RX_CH);
+	do {
+		u8Flags = DMAC->CHINTFLAG.reg;
+	} while (!(u8Flags & (DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR)));
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_MASK;
+
+	if (u8Flags & DMAC_CHINTFLAG_TERR) {
+		DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+		DMAC->CHID.reg = DMAC_CHID_ID(NM_BUS_DMA_TX_CH);
+		DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+		return M2M_ERR_BUS_FAIL;
+	}
+
+	return M2M_SUCCESS;
+}
+#endif
+
 static sint8 spi_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
 {
 	uint8 u8Dummy = 0;
 	uint8 u8SkipMosi = 0, u8SkipMiso = 0;
 
+	if (pu8Mosi && pu8Miso) {
+		return M2M_ERR_BUS_FAIL;
+	}
+
+#if defined(ARDUINO_ARCH_SAMD)
+	if (gu8DmaReady && gu8DmaEnabled && u16Sz >= NM_BUS_DMA_MIN_SZ) {
+		sint8 s8Ret;
+
+		WINC1501_SPI.beginTransaction(wifi_SPISettings);
+		digitalWrite(gi8Winc1501CsPin, LOW);
+
+		s8Ret = dma_rw(pu8Mosi, pu8Miso, u16Sz);
+
+		digitalWrite(gi8Winc1501CsPin, HIGH);
+		WINC1501_SPI.endTransaction();
+
+		return s8Ret;
+	}
+#endif
+
 	if (!pu8Mosi) {
 		pu8Mosi = &u8Dummy;
 		u8SkipMosi = 1;
@@ -85,9 +223,6 @@ static sint8 spi_rw(uint8* pu8Mosi, uint8* pu8Miso, uint16 u16Sz)
 		pu8Miso = &u8Dummy;
 		u8SkipMiso = 1;
 	}
-	else {
-		return M2M_ERR_BUS_FAIL;
-	}
 
 	WINC1501_SPI.beginTransaction(wifi_SPISettings);
 	digitalWrite(gi8Winc1501CsPin, LOW);
@@ -129,6 +264,11 @@ sint8 nm_bus_init(void * /* pvInitValue */)
 	pinMode(gi8Winc1501CsPin, OUTPUT);
 	digitalWrite(gi8Winc1501CsPin, HIGH);
 
+#if defined(ARDUINO_ARCH_SAMD)
+	/* Configure DMA for bulk transfers, if the DMAC is free. */
+	dma_init();
+#endif
+
 	/* Reset WINC1500. */
 	nm_bsp_reset();
 	nm_bsp_sleep(1);
@@ -196,5 +336,23 @@ sint8 nm_bus_reinit(void* /* config */)
 	return M2M_SUCCESS;
 }
 
+/*
+*	@fn			nm_bus_dma_enable
+*	@brief		enable or disable DMA for bulk SPI transfers
+*	@param [in]	uint8 u8Enable
+*					non-zero to use DMA when it is available
+*	@return		M2M_SUCCESS if DMA will be used and M2M_ERR_BUS_FAIL if it is unavailable or disabled
+*/
+sint8 nm_bus_dma_enable(uint8 u8Enable)
+{
+#if defined(ARDUINO_ARCH_SAMD)
+	gu8DmaEnabled = u8Enable;
+	return (gu8DmaReady && gu8DmaEnabled) ? M2M_SUCCESS : M2M_ERR_BUS_FAIL;
+#else
+	(void)u8Enable;
+	return M2M_ERR_BUS_FAIL;
+#endif
+}
+
 } // extern "C"
 
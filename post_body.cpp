@@ -0,0 +1,180 @@
+#include "post_body.h"
+#include "config.h"
+#include <ctype.h>
+
+// Request bodies are written straight into a caller supplied buffer, with
+// no String or printf involved, so that uploading never touches the heap.
+// Once the buffer is full further writes are dropped and the body is
+// reported as empty.
+typedef struct {
+  char *buffer;
+  size_t size;
+  size_t length;
+  bool overflow;
+} body_writer;
+
+static void append_char(body_writer *writer, char c) {
+  if (writer->length + 1 >= writer->size) {
+    writer->overflow = true;
+    return;
+  }
+
+  writer->buffer[writer->length++] = c;
+}
+
+static void append(body_writer *writer, const char *text) {
+  while (*text) append_char(writer, *text++);
+}
+
+// Free form config values such as the hub and cell ids are percent encoded.
+static void append_encoded(body_writer *writer, const char *text) {
+  static const char hex[] = "0123456789ABCDEF";
+
+  for (; *text; text++) {
+    char c = *text;
+
+    if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      append_char(writer, c);
+    } else {
+      append_char(writer, '%');
+      append_char(writer, hex[(uint8_t) c >> 4]);
+      append_char(writer, hex[(uint8_t) c & 0x0f]);
+    }
+  }
+}
+
+static void append_unsigned(body_writer *writer, uint32_t value) {
+  char digits[10];
+  int count = 0;
+
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+
+  while (count > 0) append_char(writer, digits[--count]);
+}
+
+static void append_signed(body_writer *writer, int32_t value) {
+  if (value < 0) {
+    append_char(writer, '-');
+    append_unsigned(writer, -(uint32_t) value);
+  } else {
+    append_unsigned(writer, value);
+  }
+}
+
+// Readings are kept in hundredths, so values go out with two decimal
+// places straight from the fixed point fields.
+static void append_hundredths(body_writer *writer, int32_t hundredths) {
+  uint32_t magnitude = hundredths < 0 ? -(uint32_t) hundredths : hundredths;
+  uint32_t fraction = magnitude % 100;
+
+  if (hundredths < 0) append_char(writer, '-');
+  append_unsigned(writer, magnitude / 100);
+  append_char(writer, '.');
+  append_char(writer, '0' + fraction / 10);
+  append_char(writer, '0' + fraction % 10);
+}
+
+static void append_heat_index(body_writer *writer, packed_reading *reading) {
+  append_hundredths(writer, lroundf(reading_heat_index(reading) * 100));
+}
+
+static void append_field(body_writer *writer, const char *name) {
+  if (writer->length > 0) append_char(writer, '&');
+  append(writer, name);
+  append_char(writer, '=');
+}
+
+// The original single reading body, still used when a batch holds one reading.
+static void format_single(body_writer *writer, packed_reading *reading) {
+  append_field(writer, "temp"); append_hundredths(writer, reading->data.temperature_f);
+  append_field(writer, "humidity"); append_hundredths(writer, reading->data.humidity);
+  append_field(writer, "heat_index"); append_heat_index(writer, reading);
+  append_field(writer, "hub"); append_encoded(writer, CONFIG.data.hub_id);
+  append_field(writer, "cell"); append_encoded(writer, CONFIG.data.cell_id);
+  append_field(writer, "time"); append_unsigned(writer, reading->data.time);
+  append_field(writer, "sp"); append_signed(writer, CONFIG.data.reading_interval_s);
+  append_field(writer, "cell_version"); append_encoded(writer, CODE_VERSION);
+}
+
+// A batch carries the per-sensor fields once plus one
+// "time,temp,humidity,heat_index" row per reading, separated by ';'.
+// A 200 response acknowledges the whole batch.
+static void format_batch(body_writer *writer, packed_reading *readings, int count) {
+  append_field(writer, "hub"); append_encoded(writer, CONFIG.data.hub_id);
+  append_field(writer, "cell"); append_encoded(writer, CONFIG.data.cell_id);
+  append_field(writer, "sp"); append_signed(writer, CONFIG.data.reading_interval_s);
+  append_field(writer, "cell_version"); append_encoded(writer, CODE_VERSION);
+  append_field(writer, "count"); append_unsigned(writer, count);
+  append_field(writer, "readings");
+
+  for (int i = 0; i < count; i++) {
+    if (i > 0) append_char(writer, ';');
+    append_unsigned(writer, readings[i].data.time); append_char(writer, ',');
+    append_hundredths(writer, readings[i].data.temperature_f); append_char(writer, ',');
+    append_hundredths(writer, readings[i].data.humidity); append_char(writer, ',');
+    append_heat_index(writer, &readings[i]);
+  }
+}
+
+static size_t finish_body(body_writer *writer) {
+  if (writer->overflow) {
+    Serial.println("request body too large for buffer");
+    writer->length = 0;
+  }
+
+  writer->buffer[writer->length] = '\0';
+  return writer->length;
+}
+
+// Write the url-encoded form body for count readings into buffer.  Returns
+// the body length, or 0 if it did not fit.
+size_t format_post_body(char *buffer, size_t size, packed_reading *readings, int count) {
+  body_writer writer = { buffer, size, 0, false };
+
+  if (size == 0) return 0;
+
+  if (count == 1) {
+    format_single(&writer, &readings[0]);
+  } else {
+    format_batch(&writer, readings, count);
+  }
+
+  return finish_body(&writer);
+}
+
+// Hourly summaries go as one "time,count,temp_min,temp_mean,temp_max,
+// humidity_min,humidity_mean,humidity_max" row each, separated by ';',
+// with time the start of the period.  Returns the body length, or 0 if it
+// did not fit.
+size_t format_summary_body(char *buffer, size_t size, summary_reading *summaries, int count) {
+  body_writer writer = { buffer, size, 0, false };
+
+  if (size == 0) return 0;
+
+  append_field(&writer, "hub"); append_encoded(&writer, CONFIG.data.hub_id);
+  append_field(&writer, "cell"); append_encoded(&writer, CONFIG.data.cell_id);
+  append_field(&writer, "sp"); append_signed(&writer, CONFIG.data.reading_interval_s);
+  append_field(&writer, "cell_version"); append_encoded(&writer, CODE_VERSION);
+  append_field(&writer, "period"); append_unsigned(&writer, SUMMARY_PERIOD_S);
+  append_field(&writer, "count"); append_unsigned(&writer, count);
+  append_field(&writer, "summaries");
+
+  for (int i = 0; i < count; i++) {
+    summary_reading_struct *summary = &summaries[i].data;
+
+    if (i > 0) append_char(&writer, ';');
+    append_unsigned(&writer, summary->time); append_char(&writer, ',');
+    append_unsigned(&writer, summary->count); append_char(&writer, ',');
+    append_hundredths(&writer, summary->temperature_f_min); append_char(&writer, ',');
+    append_hundredths(&writer, summary->temperature_f_mean); append_char(&writer, ',');
+    append_hundredths(&writer, summary->temperature_f_max); append_char(&writer, ',');
+    append_hundredths(&writer, summary->humidity_min); append_char(&writer, ',');
+    append_hundredths(&writer, summary->humidity_mean); append_char(&writer, ',');
+    append_hundredths(&writer, summary->humidity_max);
+  }
+
+  return finish_body(&writer);
+}
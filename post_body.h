@@ -0,0 +1,14 @@
+#ifndef POST_BODY_H
+#define POST_BODY_H
+
+#include <Arduino.h>
+#include "transmit.h"
+#include "reading.h"
+#include "summary.h"
+
+#define POST_BODY_SIZE  (512 + BATCH_MAX_SIZE * 40)
+
+size_t format_post_body(char *buffer, size_t size, packed_reading *readings, int count);
+size_t format_summary_body(char *buffer, size_t size, summary_reading *summaries, int count);
+
+#endif
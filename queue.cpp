@@ -0,0 +1,356 @@
+#include "queue.h"
+#include "watchdog.h"
+#include "backlog_segment.h"
+#include <SD.h>
+#include <stddef.h>
+
+#define QUEUE_MAGIC  0x48535131  // "HSQ1"
+#define QUEUE_FILE   "segments.bin"
+
+// The queue is a single preallocated file holding a ring of compressed
+// segments (see backlog_segment.h), one per sector, behind a one sector
+// header.  head and tail are free running segment counters (slot =
+// counter % capacity); tail is the segment being filled, which is also
+// kept in RAM, and head_skip counts the readings of the head segment
+// already sent.  Enqueueing rewrites the tail sector, and only touches the
+// header when a segment fills up.
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;  // bytes per slot
+  uint32_t capacity;
+  uint32_t head;
+  uint32_t tail;
+  uint16_t reading_version;  // added in queue version 2
+  uint16_t head_skip;        // added in queue version 3
+} queue_header_struct;
+
+typedef union {
+  queue_header_struct data;
+  uint8_t raw[sizeof(queue_header_struct)];
+} queue_header;
+
+static File queue_file;
+static queue_header header;
+static uint8_t tail_segment[SEGMENT_SIZE];
+static segment_cursor tail_cursor;
+static uint8_t read_segment[SEGMENT_SIZE];
+static uint32_t depth = 0;
+static uint32_t removed = 0;  // readings taken off the front since startup
+
+static uint32_t segment_offset(uint32_t counter) {
+  return QUEUE_HEADER_SIZE + (counter % QUEUE_CAPACITY) * SEGMENT_SIZE;
+}
+
+static void write_header() {
+  queue_file.seek(0);
+  queue_file.write(header.raw, sizeof(header));
+  queue_file.flush();
+}
+
+static void write_tail() {
+  queue_file.seek(segment_offset(header.data.tail));
+  queue_file.write(tail_segment, SEGMENT_SIZE);
+  queue_file.flush();
+}
+
+// Returns the segment for counter, reading it from the card unless it is
+// the tail.
+static const uint8_t *load_segment(uint32_t counter) {
+  if (counter == header.data.tail) return tail_segment;
+
+  queue_file.seek(segment_offset(counter));
+  if (queue_file.read(read_segment, SEGMENT_SIZE) != SEGMENT_SIZE) memset(read_segment, 0, SEGMENT_SIZE);
+  return read_segment;
+}
+
+static bool header_valid() {
+  return header.data.magic == QUEUE_MAGIC &&
+         header.data.version == QUEUE_VERSION &&
+         header.data.record_size == SEGMENT_SIZE &&
+         header.data.reading_version == READING_VERSION &&
+         header.data.capacity == QUEUE_CAPACITY &&
+         header.data.tail - header.data.head < QUEUE_CAPACITY;
+}
+
+// Allocate every cluster up front so that later writes never touch the FAT.
+static void create_journal() {
+  Serial.println("creating queue journal...");
+
+  uint8_t zeros[512];
+  memset(zeros, 0, sizeof(zeros));
+
+  queue_file.seek(0);
+  uint32_t size = QUEUE_HEADER_SIZE + QUEUE_CAPACITY * SEGMENT_SIZE;
+  for (uint32_t written = 0; written < size; written += sizeof(zeros)) {
+    queue_file.write(zeros, sizeof(zeros));
+    watchdog_feed();
+  }
+
+  header.data.magic = QUEUE_MAGIC;
+  header.data.version = QUEUE_VERSION;
+  header.data.record_size = SEGMENT_SIZE;
+  header.data.capacity = QUEUE_CAPACITY;
+  header.data.head = 0;
+  header.data.tail = 0;
+  header.data.reading_version = READING_VERSION;
+  header.data.head_skip = 0;
+  write_header();
+
+  Serial.println("created queue journal");
+}
+
+// Step past head segments that have been sent in full; the tail stays put.
+static void drop_sent_segments() {
+  while (header.data.head != header.data.tail) {
+    uint16_t head_count = segment_count(load_segment(header.data.head));
+    if (header.data.head_skip < head_count) break;
+
+    header.data.head_skip -= head_count;
+    header.data.head++;
+  }
+}
+
+// Load the tail segment and count what is queued.
+static bool load_journal() {
+  queue_file.seek(segment_offset(header.data.tail));
+  if (queue_file.read(tail_segment, SEGMENT_SIZE) != SEGMENT_SIZE) return false;
+
+  uint32_t time;
+  int16_t temperature_f;
+  uint16_t humidity;
+
+  segment_rewind(&tail_cursor);
+  while (segment_next(tail_segment, &tail_cursor, &time, &temperature_f, &humidity));
+
+  depth = 0;
+  for (uint32_t counter = header.data.head; counter != header.data.tail + 1; counter++) {
+    depth += segment_count(load_segment(counter));
+    watchdog_feed();
+  }
+
+  if (header.data.head_skip > depth) return false;
+  depth -= header.data.head_skip;
+  return true;
+}
+
+// Older firmware kept one file per reading in pending/, named after the
+// unix timestamp with a period after the 7th digit (1500985299 -> 1500985.299).
+// Move any of those into the journal so they still get transmitted.
+static void import_legacy_queue() {
+  if (!SD.exists("pending")) return;
+
+  Serial.println("importing pending/ into queue journal");
+
+  File pending_dir = SD.open("pending");
+  while (true) {
+    watchdog_feed();
+
+    File entry = pending_dir.openNextFile();
+    if (!entry) { break; } // No more files
+
+    char filename[100];
+    char read_time_buffer[100];
+    char file_path[100];
+    float values[3];  // temperature_f, humidity, heat_index
+
+    strcpy(filename, entry.name());
+    strncpy(read_time_buffer, filename, 7);
+    strncpy(read_time_buffer+7, filename+8, 3);
+    read_time_buffer[10] = '\0';
+
+    int read_size = entry.read(values, sizeof(values));
+    entry.close();
+
+    if (read_size == sizeof(values)) {
+      packed_reading reading;
+      reading_pack(&reading, strtoul(read_time_buffer, NULL, 0), values[0], values[1]);
+      queue_push(&reading);
+    } else {
+      Serial.print("skipping malformed queued file: ");
+      Serial.println(filename);
+    }
+
+    sprintf(file_path, "pending/%s", filename);
+    SD.remove(file_path);
+  }
+  pending_dir.close();
+
+  SD.rmdir("pending");
+}
+
+// Earlier queue versions kept fixed size records in a ring: three floats
+// per reading in queue.bin (version 1), then packed_readings in
+// backlog.bin (version 2).  Move whatever was still queued, oldest first,
+// into the journal and remove the old file.
+static void import_legacy_journal(const char *path, uint16_t version, uint16_t record_size) {
+  if (!SD.exists(path)) return;
+
+  Serial.print("importing ");
+  Serial.print(path);
+  Serial.println(" into queue journal");
+
+  File legacy_file = SD.open(path);
+  queue_header legacy;
+  int legacy_header_size = offsetof(queue_header_struct, reading_version);
+  int read_size = legacy_file.read(legacy.raw, legacy_header_size);
+
+  if (read_size == legacy_header_size &&
+      legacy.data.magic == QUEUE_MAGIC &&
+      legacy.data.version == version &&
+      legacy.data.record_size == record_size &&
+      legacy.data.capacity > 0 &&
+      legacy.data.tail - legacy.data.head <= legacy.data.capacity) {
+    for (uint32_t counter = legacy.data.head; counter != legacy.data.tail; counter++) {
+      watchdog_feed();
+
+      uint8_t record[16];
+      packed_reading reading;
+
+      legacy_file.seek(QUEUE_HEADER_SIZE + (counter % legacy.data.capacity) * record_size);
+      if (legacy_file.read(record, record_size) != record_size) break;
+
+      if (version == 1) {
+        uint32_t time;
+        float values[3];  // temperature_f, humidity, heat_index
+
+        memcpy(&time, record, sizeof(time));
+        memcpy(values, record + sizeof(time), sizeof(values));
+        reading_pack(&reading, time, values[0], values[1]);
+      } else {
+        memcpy(reading.raw, record, sizeof(reading.raw));
+      }
+
+      queue_push(&reading);
+    }
+  } else {
+    Serial.print("skipping unrecognized ");
+    Serial.println(path);
+  }
+
+  legacy_file.close();
+  SD.remove(path);
+}
+
+void queue_initialize() {
+  // not FILE_WRITE, whose O_APPEND sends every write to the end of the file
+  if (!(queue_file = SD.open(QUEUE_FILE, O_READ | O_WRITE | O_CREAT))) {
+    Serial.println("unable to open " QUEUE_FILE);
+    while(true); // watchdog will reboot
+  }
+
+  queue_file.seek(0);
+  int read_size = queue_file.read(header.raw, sizeof(header));
+
+  if (read_size != sizeof(header) || !header_valid() || !load_journal()) {
+    create_journal();
+    segment_clear(tail_segment, &tail_cursor);
+    depth = 0;
+  }
+
+  import_legacy_journal("queue.bin", 1, sizeof(uint32_t) + 3 * sizeof(float));
+  import_legacy_journal("backlog.bin", 2, sizeof(packed_reading));
+  import_legacy_queue();
+
+  Serial.print("queued readings: ");
+  Serial.println(queue_depth());
+}
+
+// When the tail fills, the new tail sector is written before the header
+// that points at it, so a reset in between can't leave the header naming a
+// sector that still holds a segment from the last time around the ring.
+// If the ring is full that sector is the head's, so the header first moves
+// head past it.
+void queue_push(packed_reading *reading) {
+  if (segment_append(tail_segment, &tail_cursor, reading->data.time, reading->data.temperature_f, reading->data.humidity)) {
+    write_tail();
+    depth++;
+    return;
+  }
+
+  if (header.data.tail + 1 - header.data.head == QUEUE_CAPACITY) {
+    Serial.println("queue full, dropping oldest segment");
+    uint32_t dropped = segment_count(load_segment(header.data.head)) - header.data.head_skip;
+    depth -= dropped;
+    removed += dropped;
+    header.data.head++;
+    header.data.head_skip = 0;
+    write_header();
+  }
+
+  header.data.tail++;
+  segment_clear(tail_segment, &tail_cursor);
+  segment_append(tail_segment, &tail_cursor, reading->data.time, reading->data.temperature_f, reading->data.humidity);
+  write_tail();
+  depth++;
+
+  drop_sent_segments();
+  write_header();
+}
+
+// Read up to max_count of the oldest readings, without removing them,
+// decoding them from their segments as they go.  Returns the number of
+// readings read.
+int queue_peek(packed_reading *readings, int max_count) {
+  return queue_peek_at(0, readings, max_count);
+}
+
+// As queue_peek, starting offset readings in from the oldest.
+int queue_peek_at(uint32_t offset, packed_reading *readings, int max_count) {
+  int count = 0;
+  uint32_t skip = header.data.head_skip + offset;
+
+  for (uint32_t counter = header.data.head; count < max_count && counter != header.data.tail + 1; counter++) {
+    const uint8_t *segment = load_segment(counter);
+    segment_cursor cursor;
+    uint32_t time;
+    int16_t temperature_f;
+    uint16_t humidity;
+
+    segment_rewind(&cursor);
+    while (count < max_count && segment_next(segment, &cursor, &time, &temperature_f, &humidity)) {
+      if (skip > 0) {
+        skip--;
+        continue;
+      }
+
+      readings[count].data.time = time;
+      readings[count].data.temperature_f = temperature_f;
+      readings[count].data.humidity = humidity;
+      count++;
+    }
+  }
+
+  return count;
+}
+
+void queue_pop(int count) {
+  if ((uint32_t) count > queue_depth()) count = queue_depth();
+  if (count == 0) return;
+
+  depth -= count;
+  removed += count;
+  header.data.head_skip += count;
+  drop_sent_segments();
+
+  write_header();
+}
+
+uint32_t queue_depth() {
+  return depth;
+}
+
+// How many readings have left the front of the queue since startup, sent
+// or dropped when it was full.  Lets a caller holding peeked readings tell
+// whether any of them are gone.
+uint32_t queue_removed() {
+  return removed;
+}
+
+void queue_clear() {
+  header.data.head = header.data.tail;
+  header.data.head_skip = segment_count(tail_segment);
+  removed += depth;
+  depth = 0;
+  write_header();
+}
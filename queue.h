@@ -0,0 +1,20 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <Arduino.h>
+#include "reading.h"
+
+#define QUEUE_VERSION      3     // compressed segments, in segments.bin
+#define QUEUE_CAPACITY     128   // segments; roughly 150-200 readings each
+#define QUEUE_HEADER_SIZE  512   // header gets its own sector so records stay sector aligned
+
+void queue_initialize();
+void queue_push(packed_reading *reading);
+int queue_peek(packed_reading *readings, int max_count);
+int queue_peek_at(uint32_t offset, packed_reading *readings, int max_count);
+void queue_pop(int count);
+uint32_t queue_depth();
+uint32_t queue_removed();
+void queue_clear();
+
+#endif
@@ -0,0 +1,43 @@
+#include "reading.h"
+
+void reading_pack(packed_reading *reading, uint32_t time, float temperature_f, float humidity) {
+  reading->data.time = time;
+  reading->data.temperature_f = constrain(lroundf(temperature_f * 100), INT16_MIN, INT16_MAX);
+  reading->data.humidity = constrain(lroundf(humidity * 100), 0, UINT16_MAX);
+}
+
+float reading_temperature_f(packed_reading *reading) {
+  return reading->data.temperature_f / 100.0;
+}
+
+float reading_humidity(packed_reading *reading) {
+  return reading->data.humidity / 100.0;
+}
+
+// Rothfusz regression with Steadman's simple formula below 80 F, the same
+// calculation as DHT::computeHeatIndex.
+float reading_heat_index(packed_reading *reading) {
+  float t = reading_temperature_f(reading);
+  float rh = reading_humidity(reading);
+  float hi = 0.5 * (t + 61.0 + ((t - 68.0) * 1.2) + (rh * 0.094));
+
+  if (hi > 79) {
+    hi = -42.379 +
+             2.04901523 * t +
+            10.14333127 * rh +
+            -0.22475541 * t * rh +
+            -0.00683783 * t * t +
+            -0.05481717 * rh * rh +
+             0.00122874 * t * t * rh +
+             0.00085282 * t * rh * rh +
+            -0.00000199 * t * t * rh * rh;
+
+    if (rh < 13 && t >= 80.0 && t <= 112.0) {
+      hi -= ((13.0 - rh) * 0.25) * sqrt((17.0 - fabs(t - 95.0)) * 0.05882);
+    } else if (rh > 85.0 && t >= 80.0 && t <= 87.0) {
+      hi += ((rh - 85.0) * 0.1) * ((87.0 - t) * 0.2);
+    }
+  }
+
+  return hi;
+}
@@ -0,0 +1,29 @@
+#ifndef READING_H
+#define READING_H
+
+#include <Arduino.h>
+
+// Layout version of packed_reading, stored in the headers of the files
+// that hold them rather than in every record.
+#define READING_VERSION  1
+
+// One sensor reading as it is logged, queued and transmitted.  The DHT22
+// only resolves 0.1 C / 0.1 %RH, so hundredths lose nothing, and heat
+// index is derived from the other two when a body is built.
+typedef struct {
+  uint32_t time;
+  int16_t temperature_f;  // hundredths of a degree F
+  uint16_t humidity;      // hundredths of a percent RH
+} packed_reading_struct;
+
+typedef union {
+  packed_reading_struct data;
+  uint8_t raw[sizeof(packed_reading_struct)];
+} packed_reading;
+
+void reading_pack(packed_reading *reading, uint32_t time, float temperature_f, float humidity);
+float reading_temperature_f(packed_reading *reading);
+float reading_humidity(packed_reading *reading);
+float reading_heat_index(packed_reading *reading);
+
+#endif
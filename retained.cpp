@@ -0,0 +1,14 @@
+#include "retained.h"
+
+// FNV-1a
+uint32_t retained_checksum(const void *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t *) data;
+  uint32_t hash = 2166136261UL;
+
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619UL;
+  }
+
+  return hash;
+}
@@ -0,0 +1,21 @@
+#ifndef RETAINED_H
+#define RETAINED_H
+
+#include <Arduino.h>
+
+// Variables marked RETAINED are left alone by the startup code, so they keep
+// their value across a watchdog or software reset.  After a power cycle they
+// hold garbage, so anything stored in them needs a magic number and a
+// checksum.  Only SAMD boards are supported; elsewhere RETAINED_RAM is 0 and
+// callers should fall back to the SD card.
+#ifdef ARDUINO_ARCH_SAMD
+  #define RETAINED      __attribute__((section(".noinit")))
+  #define RETAINED_RAM  1
+#else
+  #define RETAINED
+  #define RETAINED_RAM  0
+#endif
+
+uint32_t retained_checksum(const void *data, size_t size);
+
+#endif
@@ -0,0 +1,103 @@
+#include "scheduler.h"
+#include "watchdog.h"
+#include "rtc.h"
+
+#if defined(HEATSEEK_FEATHER_WIFI_M0) || defined(TRANSMITTER_GSM)
+  #include <Adafruit_SleepyDog.h>
+  #define STANDBY_SUPPORTED
+#endif
+
+// millis() stops while the SAMD21 is in standby, so it only counts time
+// spent awake.  Time asleep is measured against the RTC.
+static uint32_t asleep_ms = 0;
+
+#if defined(STANDBY_SUPPORTED) && defined(RTC_INT_PIN)
+  static void rtc_interrupt() {
+    // INT1 is level triggered and stays low until the flag is cleared
+    detachInterrupt(digitalPinToInterrupt(RTC_INT_PIN));
+  }
+
+  // The PCF8523 countdown only counts to 255, so long sleeps are counted in
+  // minutes and topped up in seconds once the minutes have run out.
+  static void arm_rtc_timer(int32_t remaining_s) {
+    if (remaining_s > 255) {
+      rtc.enableCountdownTimer(PCF8523_FrequencyMinute, min(remaining_s / 60, (int32_t) 255));
+    } else {
+      rtc.enableCountdownTimer(PCF8523_FrequencySecond, remaining_s);
+    }
+  }
+
+  // With the RTC's INT pin wired up, the countdown timer wakes us exactly at
+  // wake_time and the RTC only needs to be read when the timer fires.  The
+  // watchdog still wakes us every SLEEP_CHUNK_MS so it can be re-armed.
+  static void standby_until(uint32_t wake_time) {
+    pinMode(RTC_INT_PIN, INPUT_PULLUP);
+
+    int32_t remaining_s = wake_time - rtc.now().unixtime();
+    if (remaining_s <= 0) return;
+    arm_rtc_timer(remaining_s);
+
+    while (true) {
+      if (digitalRead(RTC_INT_PIN) == LOW) {
+        remaining_s = wake_time - rtc.now().unixtime();
+        if (remaining_s <= 0) break;
+        arm_rtc_timer(remaining_s);
+      }
+
+      attachInterrupt(digitalPinToInterrupt(RTC_INT_PIN), rtc_interrupt, LOW);
+      Watchdog.sleep(SLEEP_CHUNK_MS);
+      detachInterrupt(digitalPinToInterrupt(RTC_INT_PIN));
+      watchdog_init(); // waking leaves the watchdog disabled
+    }
+
+    rtc.disableCountdownTimer();
+  }
+#elif defined(STANDBY_SUPPORTED)
+  // Sleep in chunks shorter than the watchdog period, woken by the watchdog
+  // early warning interrupt, checking the RTC after every chunk.
+  static void standby_until(uint32_t wake_time) {
+    while (true) {
+      int32_t remaining_s = wake_time - rtc.now().unixtime();
+      if (remaining_s <= 0) break;
+
+      uint32_t period_ms = min((uint32_t) remaining_s * 1000, (uint32_t) SLEEP_CHUNK_MS);
+      Watchdog.sleep(period_ms);
+      watchdog_init(); // the early warning interrupt leaves the watchdog disabled
+    }
+  }
+#endif
+
+// Sleep until the RTC reaches wake_time (unix seconds), with the MCU in
+// standby and the watchdog re-armed around every sleep.
+//
+// USB serial doesn't survive standby, so while a terminal is attached we
+// only wait a couple of seconds and return, which keeps the [C] config
+// prompt in loop() working.
+void scheduler_sleep_until(uint32_t wake_time) {
+  #ifdef STANDBY_SUPPORTED
+    if (!Serial) {
+      uint32_t start_time = rtc.now().unixtime();
+      uint32_t start_ms = millis();
+
+      standby_until(wake_time);
+
+      uint32_t elapsed_ms = (rtc.now().unixtime() - start_time) * 1000;
+      uint32_t awake_ms = millis() - start_ms;
+      if (elapsed_ms > awake_ms) asleep_ms += elapsed_ms - awake_ms;
+      return;
+    }
+  #endif
+
+  delay(2000);
+  watchdog_feed();
+}
+
+void scheduler_report_duty_cycle() {
+  uint32_t awake_ms = millis();
+
+  Serial.print("awake: "); Serial.print(awake_ms / 1000);
+  Serial.print("s, asleep: "); Serial.print(asleep_ms / 1000);
+  Serial.print("s, duty cycle: ");
+  Serial.print(100.0 * awake_ms / (awake_ms + asleep_ms));
+  Serial.println("%");
+}
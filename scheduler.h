@@ -0,0 +1,13 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define SLEEP_CHUNK_MS           8000  // must stay below the 16 second watchdog
+#define DRAIN_RETRY_INTERVAL_S   60
+#define DRAIN_RETRY_MAX_INTERVAL_S  (60 * 60)
+
+void scheduler_sleep_until(uint32_t wake_time);
+void scheduler_report_duty_cycle();
+
+#endif
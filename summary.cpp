@@ -0,0 +1,223 @@
+#include "summary.h"
+#include "queue.h"
+#include "config.h"
+#include "watchdog.h"
+#include <SD.h>
+
+#define SUMMARY_MAGIC  0x48535331  // "HSS1"
+#define SUMMARY_FILE   "summary.bin"
+#define COMPACT_PEEK_SIZE  64
+
+// Hourly summaries of readings compacted out of a deep backlog.  Like the
+// queue journal before it held segments, this is a preallocated ring of
+// fixed size records behind a one sector header, with head and tail as
+// free running counters.
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t capacity;
+  uint32_t head;
+  uint32_t tail;
+} summary_header_struct;
+
+typedef union {
+  summary_header_struct data;
+  uint8_t raw[sizeof(summary_header_struct)];
+} summary_header;
+
+static File summary_file;
+static summary_header header;
+
+static uint32_t record_offset(uint32_t counter) {
+  return SUMMARY_HEADER_SIZE + (counter % SUMMARY_CAPACITY) * sizeof(summary_reading);
+}
+
+static void write_header() {
+  summary_file.seek(0);
+  summary_file.write(header.raw, sizeof(header));
+  summary_file.flush();
+}
+
+static bool header_valid() {
+  return header.data.magic == SUMMARY_MAGIC &&
+         header.data.version == SUMMARY_VERSION &&
+         header.data.record_size == sizeof(summary_reading) &&
+         header.data.capacity == SUMMARY_CAPACITY &&
+         header.data.tail - header.data.head <= SUMMARY_CAPACITY;
+}
+
+// Allocate every cluster up front so that later writes never touch the FAT.
+static void create_journal() {
+  Serial.println("creating summary journal...");
+
+  uint8_t zeros[512];
+  memset(zeros, 0, sizeof(zeros));
+
+  summary_file.seek(0);
+  uint32_t size = SUMMARY_HEADER_SIZE + SUMMARY_CAPACITY * sizeof(summary_reading);
+  for (uint32_t written = 0; written < size; written += sizeof(zeros)) {
+    summary_file.write(zeros, sizeof(zeros));
+    watchdog_feed();
+  }
+
+  header.data.magic = SUMMARY_MAGIC;
+  header.data.version = SUMMARY_VERSION;
+  header.data.record_size = sizeof(summary_reading);
+  header.data.capacity = SUMMARY_CAPACITY;
+  header.data.head = 0;
+  header.data.tail = 0;
+  write_header();
+
+  Serial.println("created summary journal");
+}
+
+void summary_initialize() {
+  // not FILE_WRITE, whose O_APPEND sends every write to the end of the file
+  if (!(summary_file = SD.open(SUMMARY_FILE, O_READ | O_WRITE | O_CREAT))) {
+    Serial.println("unable to open " SUMMARY_FILE);
+    while(true); // watchdog will reboot
+  }
+
+  summary_file.seek(0);
+  int read_size = summary_file.read(header.raw, sizeof(header));
+
+  if (read_size != sizeof(header) || !header_valid()) {
+    create_journal();
+  }
+
+  Serial.print("queued summaries: ");
+  Serial.println(summary_depth());
+}
+
+void summary_push(summary_reading *summary) {
+  if (summary_depth() == SUMMARY_CAPACITY) {
+    Serial.println("summaries full, dropping oldest hour");
+    header.data.head++;
+  }
+
+  summary_file.seek(record_offset(header.data.tail));
+  summary_file.write(summary->raw, sizeof(*summary));
+  summary_file.flush();
+
+  header.data.tail++;
+  write_header();
+}
+
+// Read up to max_count of the oldest summaries, without removing them.
+// Returns the number of summaries read.
+int summary_peek(summary_reading *summaries, int max_count) {
+  int count = 0;
+
+  while (count < max_count && (uint32_t) count < summary_depth()) {
+    summary_file.seek(record_offset(header.data.head + count));
+    if (summary_file.read(summaries[count].raw, sizeof(summary_reading)) != sizeof(summary_reading)) break;
+    count++;
+  }
+
+  return count;
+}
+
+void summary_pop(int count) {
+  if ((uint32_t) count > summary_depth()) count = summary_depth();
+  if (count == 0) return;
+
+  header.data.head += count;
+  write_header();
+}
+
+uint32_t summary_depth() {
+  return header.data.tail - header.data.head;
+}
+
+void summary_clear() {
+  header.data.head = header.data.tail;
+  write_header();
+}
+
+// Running totals for the summary of one hour.
+typedef struct {
+  summary_reading summary;
+  int32_t temperature_total;
+  uint32_t humidity_total;
+} summary_accumulator;
+
+static void summary_add(summary_accumulator *accumulator, packed_reading *reading) {
+  summary_reading_struct *summary = &accumulator->summary.data;
+
+  if (summary->count == 0) {
+    summary->time = reading->data.time - reading->data.time % SUMMARY_PERIOD_S;
+    summary->temperature_f_min = summary->temperature_f_max = reading->data.temperature_f;
+    summary->humidity_min = summary->humidity_max = reading->data.humidity;
+  }
+
+  summary->temperature_f_min = min(summary->temperature_f_min, reading->data.temperature_f);
+  summary->temperature_f_max = max(summary->temperature_f_max, reading->data.temperature_f);
+  summary->humidity_min = min(summary->humidity_min, reading->data.humidity);
+  summary->humidity_max = max(summary->humidity_max, reading->data.humidity);
+
+  accumulator->temperature_total += reading->data.temperature_f;
+  accumulator->humidity_total += reading->data.humidity;
+  summary->count++;
+}
+
+static void summary_finish(summary_accumulator *accumulator) {
+  summary_reading_struct *summary = &accumulator->summary.data;
+
+  summary->temperature_f_mean = lroundf((float) accumulator->temperature_total / summary->count);
+  summary->humidity_mean = lroundf((float) accumulator->humidity_total / summary->count);
+}
+
+// Summarize the oldest queued hour, if every reading of it is older than
+// the newest keep readings, i.e. a reading from a later hour turns up
+// before the keep window starts.  Returns false if there is no such hour.
+static bool compact_oldest_hour(uint32_t keep) {
+  packed_reading readings[COMPACT_PEEK_SIZE];
+  summary_accumulator accumulator;
+  uint32_t eligible = queue_depth() - keep;
+
+  memset(&accumulator, 0, sizeof(accumulator));
+
+  while (accumulator.summary.data.count < eligible) {
+    watchdog_feed();
+
+    uint32_t offset = accumulator.summary.data.count;
+    int count = queue_peek_at(offset, readings, min((uint32_t) COMPACT_PEEK_SIZE, eligible - offset));
+    if (count == 0) return false;
+
+    for (int i = 0; i < count; i++) {
+      if (accumulator.summary.data.count > 0 &&
+          readings[i].data.time - accumulator.summary.data.time >= SUMMARY_PERIOD_S) {
+        summary_finish(&accumulator);
+        summary_push(&accumulator.summary);
+        queue_pop(accumulator.summary.data.count);
+        return true;
+      }
+
+      summary_add(&accumulator, &readings[i]);
+    }
+  }
+
+  return false;
+}
+
+// While more than CONFIG.data.compact_depth raw readings are queued, roll
+// each oldest hour that lies wholly before them into one summary, so that a long outage uploads
+// as an hourly history first and full resolution only for the most
+// recent readings.  Must not run while a drain is in progress.
+void compact_backlog() {
+  if (CONFIG.data.compact_depth == 0) return;
+
+  int hours = 0;
+
+  while (hours < COMPACT_HOURS_PER_CALL &&
+         queue_depth() > CONFIG.data.compact_depth &&
+         compact_oldest_hour(CONFIG.data.compact_depth)) {
+    hours++;
+  }
+
+  if (hours > 0) {
+    Serial.print("compacted backlog into summaries: ");
+    Serial.println(hours);
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <Arduino.h>
+#include "reading.h"
+
+#define SUMMARY_VERSION        1
+#define SUMMARY_CAPACITY       2048  // hours; ~85 days
+#define SUMMARY_HEADER_SIZE    512
+#define SUMMARY_PERIOD_S       (60 * 60)
+#define SUMMARY_BATCH_SIZE     10    // rows are about three readings long
+#define DEFAULT_COMPACT_DEPTH  (7 * 24 * 12)  // a week at a 5 minute reading interval
+#define COMPACT_HOURS_PER_CALL (7 * 24)
+
+// min/mean/max of the readings taken in one hour, in packed_reading units.
+typedef struct {
+  uint32_t time;  // start of the hour
+  uint16_t count;
+  int16_t temperature_f_min;
+  int16_t temperature_f_mean;
+  int16_t temperature_f_max;
+  uint16_t humidity_min;
+  uint16_t humidity_mean;
+  uint16_t humidity_max;
+} summary_reading_struct;
+
+typedef union {
+  summary_reading_struct data;
+  uint8_t raw[sizeof(summary_reading_struct)];
+} summary_reading;
+
+void summary_initialize();
+void summary_push(summary_reading *summary);
+int summary_peek(summary_reading *summaries, int max_count);
+void summary_pop(int count);
+uint32_t summary_depth();
+void summary_clear();
+void compact_backlog();
+
+#endif
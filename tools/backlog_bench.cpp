@@ -0,0 +1,122 @@
+// Bytes per reading of the compressed backlog format against the CSV log
+// and packed_reading records, for one or more data.csv exports.
+//
+//   g++ -O2 -o backlog_bench tools/backlog_bench.cpp backlog_segment.cpp
+//   ./backlog_bench DATA.CSV [more.csv ...]
+//
+// Each line is time,temperature_f,humidity[,heat_index] as logged by older
+// firmware.  Every reading is decoded again and checked against the input.
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "../backlog_segment.h"
+
+#define PACKED_READING_SIZE  8
+
+typedef struct {
+  uint32_t readings;
+  uint32_t segments;
+  uint64_t csv_bytes;
+} bench_totals;
+
+static bool check_segment(const uint8_t *segment, const uint32_t *times, const int16_t *temperatures,
+                          const uint16_t *humidities, uint16_t count) {
+  segment_cursor cursor;
+  uint32_t time;
+  int16_t temperature_f;
+  uint16_t humidity;
+  uint16_t i = 0;
+
+  segment_rewind(&cursor);
+  while (segment_next(segment, &cursor, &time, &temperature_f, &humidity)) {
+    if (i >= count || time != times[i] || temperature_f != temperatures[i] || humidity != humidities[i]) return false;
+    i++;
+  }
+
+  return i == count;
+}
+
+static bool bench_file(const char *path, bench_totals *totals) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+
+  uint8_t segment[SEGMENT_SIZE];
+  segment_cursor cursor;
+  // at most one reading per 3 bits after the first
+  static uint32_t times[SEGMENT_DATA_BITS / 3 + 1];
+  static int16_t temperatures[SEGMENT_DATA_BITS / 3 + 1];
+  static uint16_t humidities[SEGMENT_DATA_BITS / 3 + 1];
+  uint16_t count = 0;
+  bool ok = true;
+  char line[128];
+
+  segment_clear(segment, &cursor);
+
+  while (fgets(line, sizeof(line), file)) {
+    unsigned long time;
+    float temperature_f, humidity;
+
+    if (sscanf(line, "%lu,%f,%f", &time, &temperature_f, &humidity) != 3) continue;
+
+    int16_t temperature_fixed = (int16_t) lroundf(temperature_f * 100);
+    uint16_t humidity_fixed = (uint16_t) lroundf(humidity * 100);
+
+    if (!segment_append(segment, &cursor, time, temperature_fixed, humidity_fixed)) {
+      ok = ok && check_segment(segment, times, temperatures, humidities, count);
+      totals->segments++;
+
+      segment_clear(segment, &cursor);
+      count = 0;
+      segment_append(segment, &cursor, time, temperature_fixed, humidity_fixed);
+    }
+
+    times[count] = time;
+    temperatures[count] = temperature_fixed;
+    humidities[count] = humidity_fixed;
+    count++;
+
+    totals->readings++;
+    totals->csv_bytes += strlen(line);
+  }
+
+  if (count > 0) {
+    ok = ok && check_segment(segment, times, temperatures, humidities, count);
+    totals->segments++;
+  }
+
+  fclose(file);
+
+  if (!ok) fprintf(stderr, "%s: decoded readings do not match\n", path);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s data.csv [more.csv ...]\n", argv[0]);
+    return 2;
+  }
+
+  bool ok = true;
+
+  for (int i = 1; i < argc; i++) {
+    bench_totals totals = { 0, 0, 0 };
+    ok = bench_file(argv[i], &totals) && ok;
+
+    if (totals.readings == 0) {
+      printf("%s: no readings\n", argv[i]);
+      continue;
+    }
+
+    printf("%s: %u readings\n", argv[i], totals.readings);
+    printf("  csv        %6.2f bytes/reading\n", (double) totals.csv_bytes / totals.readings);
+    printf("  packed     %6.2f bytes/reading\n", (double) PACKED_READING_SIZE);
+    printf("  segments   %6.2f bytes/reading (%u sectors)\n",
+           (double) totals.segments * SEGMENT_SIZE / totals.readings, totals.segments);
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// Reference decoder for the queue journal (segments.bin) written by the
+// sensor.  Prints every reading still queued as time,temp,humidity.
+//
+//   g++ -O2 -o backlog_decode tools/backlog_decode.cpp backlog_segment.cpp
+//   ./backlog_decode /media/sd/SEGMENTS.BIN
+//
+// With --all it also prints readings that have already been sent.
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "../backlog_segment.h"
+
+#define QUEUE_MAGIC        0x48535131  // "HSQ1"
+#define QUEUE_VERSION      3
+#define QUEUE_HEADER_SIZE  512
+
+// Mirrors queue_header_struct in queue.cpp.
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t capacity;
+  uint32_t head;
+  uint32_t tail;
+  uint16_t reading_version;
+  uint16_t head_skip;
+} queue_header;
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  bool all = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--all") == 0) {
+      all = true;
+    } else {
+      path = argv[i];
+    }
+  }
+
+  if (!path) {
+    fprintf(stderr, "usage: %s [--all] segments.bin\n", argv[0]);
+    return 2;
+  }
+
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return 1;
+  }
+
+  queue_header header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      header.magic != QUEUE_MAGIC || header.version != QUEUE_VERSION ||
+      header.record_size != SEGMENT_SIZE || header.capacity == 0) {
+    fprintf(stderr, "%s: not a version %d queue journal\n", path, QUEUE_VERSION);
+    return 1;
+  }
+
+  uint32_t first = header.head;
+  if (all) first = header.tail + 1 > header.capacity ? header.tail + 1 - header.capacity : 0;
+  uint32_t skip = all ? 0 : header.head_skip;
+  uint32_t readings = 0;
+
+  for (uint32_t counter = first; counter != header.tail + 1; counter++) {
+    uint8_t segment[SEGMENT_SIZE];
+
+    fseek(file, QUEUE_HEADER_SIZE + (long) (counter % header.capacity) * SEGMENT_SIZE, SEEK_SET);
+    if (fread(segment, SEGMENT_SIZE, 1, file) != 1) {
+      fprintf(stderr, "%s: short segment %u\n", path, counter);
+      return 1;
+    }
+
+    segment_cursor cursor;
+    uint32_t time;
+    int16_t temperature_f;
+    uint16_t humidity;
+
+    segment_rewind(&cursor);
+    while (segment_next(segment, &cursor, &time, &temperature_f, &humidity)) {
+      if (skip > 0) {
+        skip--;
+        continue;
+      }
+
+      printf("%u,%.2f,%.2f\n", time, temperature_f / 100.0, humidity / 100.0);
+      readings++;
+    }
+  }
+
+  fprintf(stderr, "%u readings in %u segments\n", readings, header.tail + 1 - first);
+  fclose(file);
+  return 0;
+}
@@ -1,7 +1,50 @@
+#include <stddef.h>
 #include "transmit.h"
 #include "config.h"
 #include "watchdog.h"
-#include <SD.h>
+#include "queue.h"
+#include "post_body.h"
+#include "heap.h"
+#include "rtc.h"
+#include "wifi_cache.h"
+#include "latency.h"
+#include "scheduler.h"
+#include "http_response.h"
+#include "retained.h"
+#include "summary.h"
+
+#if HTTP_CLIENT_TIMEOUT_MS >= WATCHDOG_PERIOD_MS / 100 * WATCHDOG_SAFE_PERCENT
+  #error "HTTP_CLIENT_TIMEOUT_MS must leave a step well inside the watchdog period"
+#endif
+
+// Uploads run as a state machine that transmit_step() advances one step per
+// pass through loop().  Each backend implements the steps below without
+// waiting on the network, or with the shortest wait its library allows, so
+// a slow access point, DNS server or cell network only delays uploads and
+// never the next reading.
+typedef enum {
+  STEP_PENDING,
+  STEP_DONE,
+  STEP_FAILED
+} step_result;
+
+typedef enum {
+  TRANSMIT_IDLE,
+  TRANSMIT_CONNECT,
+  TRANSMIT_RESOLVE,
+  TRANSMIT_SEND,
+  TRANSMIT_AWAIT_STATUS,
+  TRANSMIT_DEQUEUE
+} transmit_state;
+
+// Shared by all backends; only one request is built at a time.
+static char post_body[POST_BODY_SIZE];
+
+#ifdef TRANSMITTER_WIFI
+  uint16_t link_attempts = 0;
+  uint16_t link_failures = 0;
+  latency_stats association_latency;
+#endif
 
 #ifdef HEATSEEK_FEATHER_WIFI_WICED
   AdafruitHTTP http;
@@ -11,446 +54,1218 @@
 #endif
 
 #ifdef HEATSEEK_FEATHER_WIFI_M0
+  typedef enum {
+    WIFI_DOWN,
+    WIFI_ASSOCIATING,
+    WIFI_DHCP,
+    WIFI_UP
+  } wifi_link_state;
+
   WiFiClient wifiClient;
-  bool wifiConnected = false;
+  wifi_link_state wifi_state = WIFI_DOWN;
+  uint32_t wifi_state_started = 0;
+
+  // One keep-alive connection is shared by every request in a drain of the
+  // queue.  endpoint_domain is read when connecting, so config changes are
+  // picked up by the next connection.
+  HttpClient http_client = HttpClient(wifiClient, CONFIG.data.endpoint_domain, PORT);
+  uint16_t connection_request_count = 0;
+  http_response wifi_response;
+
+  bool wifi_fast = false;  // joined, or joining, from the cache
+  uint32_t wifi_connect_started = 0;
+  wifi_cache wifi_ap;
+  latency_stats dhcp_latency;
+
+  IPAddress server_ip;
+  bool resolving = false;
+  bool socket_connecting = false;
 #endif
 
 #ifdef TRANSMITTER_GSM
-  #include <avr/dtostrf.h>
-
   HardwareSerial *fonaSerial = &Serial1;
 
   Adafruit_FONA fona = Adafruit_FONA(FONA_RST);
+  bool fonaStarted = false;
   bool gsmConnected = false;
+  uint32_t fona_next_attempt = 0;
+  uint16_t fona_status = 0;
+
+  // Highest first, so an autobauding FONA locks on to the fastest rate
+  static const uint32_t fona_bauds[] = {115200, 57600, 38400, 19200, 9600, 4800};
+  #define FONA_BAUD_COUNT  (sizeof(fona_bauds) / sizeof(fona_bauds[0]))
+
+  uint32_t fona_baud = 0;  // rate the serial link is running at
+  int8_t fona_probe = -1;  // next entry of fona_bauds to try, -1 for the stored rate
+  uint8_t fona_probes = 0; // rates tried since the FONA last answered
+
+  // The SIM800's HTTP service set up for fona_session_url, or with
+  // FONA_RAW_TCP a socket open to that host
+  bool fona_session = false;
+  char fona_session_url[200];
+
+  #ifdef FONA_RAW_TCP
+    char fona_request[FONA_REQUEST_HEADER_SIZE + POST_BODY_SIZE];
+    http_response fona_response;
+  #else
+    uint32_t fona_session_used = 0;  // unix time, as millis() stops while we sleep
+  #endif
 #endif
 
 #ifdef TRANSMITTER_GSM
-  bool fona_post(float temperature_f, float humidity, float heat_index, uint32_t current_time) {
-    fona.HTTP_POST_end();
-              
-    uint16_t statuscode;
-    int16_t length;
+  bool transmit_configured() {
+    return CONFIG.data.cell_configured && CONFIG.data.endpoint_configured;
+  }
 
-    char url[200];
-    strcpy(url, CONFIG.data.endpoint_domain);
-    strcat(url, CONFIG.data.endpoint_path);
+  void close_fona_session() {
+    if (!fona_session) return;
+
+    #ifdef FONA_RAW_TCP
+      fona.TCPclose();
+    #else
+      fona.HTTP_POST_session_end();
+    #endif
+    fona_session = false;
+  }
 
-    char data[200];
+  void link_reset() {
+    close_fona_session();
+    fonaStarted = false;
+    gsmConnected = false;
+  }
 
-    char temperature_buffer[10];
-    char humidity_buffer[10];
-    char heat_index_buffer[10];
+  int8_t fona_baud_index(uint32_t baud) {
+    for (uint8_t i = 0; i < FONA_BAUD_COUNT; i++) {
+      if (fona_bauds[i] == baud) return i;
+    }
+    return -1;
+  }
 
-    dtostrf(temperature_f, 4, 3, temperature_buffer);
-    dtostrf(humidity, 4, 3, humidity_buffer);
-    dtostrf(heat_index, 4, 3, heat_index_buffer);
+  bool fona_round_trips_clean() {
+    for (uint8_t i = 0; i < FONA_BAUD_CHECKS; i++) {
+      if (!fona.sendCheckReply(F("AT"), F("OK"))) return false;
+    }
+    return true;
+  }
 
-    sprintf(data, "temp=%s&humidity=%s&heat_index=%s&hub=%s&cell=%s&time=%d&sp=%d&cell_version=%s", temperature_buffer, humidity_buffer, heat_index_buffer, CONFIG.data.hub_id, CONFIG.data.cell_id, current_time, CONFIG.data.reading_interval_s, CODE_VERSION);
+  // The stored rate is tried first.  If the FONA doesn't answer there, the
+  // rates below it are probed and then the ones above, so a rate we backed
+  // off from is only used again when nothing slower works.  Each try resets
+  // the FONA, so only one is made per pass.
+  bool start_fona() {
+    if (fona_probe < 0 && CONFIG.data.fona_baud == 0) fona_probe = 0;
+    fona_baud = fona_probe < 0 ? CONFIG.data.fona_baud : fona_bauds[fona_probe];
 
-    Serial.print("posting to: "); Serial.println(url);
-    Serial.print("with data: "); Serial.println(data);
+    Serial.print("starting fona serial at ");
+    Serial.println(fona_baud);
+    fonaSerial->begin(fona_baud);
 
-    if (!fona.HTTP_POST_start(url, F("application/x-www-form-urlencoded"), (uint8_t *) data, strlen(data), &statuscode, (uint16_t *)&length)) {
+    if (!fona.begin(*fonaSerial) || !fona_round_trips_clean()) {
+      fona_probe = (fona_probe < 0 ? fona_baud_index(CONFIG.data.fona_baud) : fona_probe) + 1;
+      if (fona_probe >= (int8_t) FONA_BAUD_COUNT) fona_probe = 0;
       return false;
     }
 
-    Serial.println("reading status");
+    fona_probe = -1;
+    fona_probes = 0;
 
-    if (statuscode != 200) {
-      Serial.print("status not 200: ");
-      Serial.println(statuscode);
-      return false;
+    // pin the rate so the FONA stops autobauding, and remember it
+    if (fona_baud != CONFIG.data.fona_baud) {
+      fona.setBaudrate(fona_baud);
+      CONFIG.data.fona_baud = fona_baud;
+      write_config();
     }
 
-    fona.HTTP_POST_end();
     return true;
   }
 
-  void connect_to_fona() {
-    Serial.println('starting fona serial');
-    fonaSerial->begin(4800);
-    
-    Serial.println('starting fona serial 2');
-    if (!fona.begin(*fonaSerial)) {
-      Serial.println("Couldn't find FONA");
-      while(true); // watchdog will reboot
+  // Garbled AT replies mean the line can't keep up at this rate.  The FONA
+  // is asked to drop a step; if it misses that, probing finds it again.
+  void fona_step_down() {
+    int8_t index = fona_baud_index(fona_baud);
+    if (index < 0 || index + 1 >= (int8_t) FONA_BAUD_COUNT) return;
+
+    uint32_t lower = fona_bauds[index + 1];
+
+    Serial.print("garbled replies at ");
+    Serial.print(fona_baud);
+    Serial.print(" baud, dropping to ");
+    Serial.println(lower);
+
+    fona.setBaudrate(lower);
+    CONFIG.data.fona_baud = lower;
+    write_config();
+  }
+
+  // A link that can't be brought up is started from scratch next time.  If
+  // the FONA no longer answers AT cleanly the baud rate is the likely cause.
+  void link_failed(transmit_state failed_state) {
+    // the HTTP service may be mid-request; start it fresh
+    close_fona_session();
+
+    if (fonaStarted && !fona_round_trips_clean()) {
+      fona_step_down();
+      link_reset();
     }
 
-    watchdog_feed();
-    delay(2000);
+    if (failed_state == TRANSMIT_CONNECT) link_reset();
+  }
+
+  // The FONA queues codes that arrive between commands.  A deactivated PDP
+  // context means GPRS has to be attached again.
+  void check_fona_urcs() {
+    char urc[FONA_URC_LENGTH];
 
-    Serial.println('enabling FONA GPRS');
+    while (fona.readURC(urc, sizeof(urc))) {
+      Serial.print("FONA: ");
+      Serial.println(urc);
 
-    uint32_t start = millis();
-    
-    while (!fona.enableGPRS(true)) {
-      delay(1000);
-      watchdog_feed();
+      if (strncmp(urc, "+PDP: DEACT", 11) == 0) gsmConnected = false;
 
-      if (millis() - start > 60000) {
-        Serial.println("failed to start FONA GPRS after 60 sec");
-        while (true);
+      #ifdef FONA_RAW_TCP
+        if (strcmp(urc, "CLOSED") == 0) fona_session = false;
+      #endif
+    }
+  }
+
+  // Starting the FONA and attaching to GPRS are each a series of AT
+  // commands with their own timeouts, so attach attempts are spread over
+  // passes instead of retried in a loop.
+  step_result link_connect() {
+    if (fonaStarted) check_fona_urcs();
+    if (gsmConnected) return STEP_DONE;
+
+    if (!fonaStarted) {
+      if (!start_fona()) {
+        if (++fona_probes <= FONA_BAUD_COUNT) return STEP_PENDING;
+
+        Serial.println("Couldn't find FONA");
+        fona_probes = 0;
+        return STEP_FAILED;
       }
+
+      Serial.println("enabling FONA GPRS");
+      fonaStarted = true;
+      fona_next_attempt = millis() + 2000;
+      return STEP_PENDING;
     }
-    
-    Serial.println("Enabled FONA GRPS");
 
+    if ((int32_t) (millis() - fona_next_attempt) < 0) return STEP_PENDING;
+
+    if (!fona.enableGPRS(true)) {
+      fona_next_attempt = millis() + 1000;
+      return STEP_PENDING;
+    }
+
+    Serial.println("Enabled FONA GPRS");
     gsmConnected = true;
+    return STEP_DONE;
   }
 
-  bool _transmit(float temperature_f, float humidity, float heat_index, uint32_t current_time) {
-    if (!CONFIG.data.cell_configured || !CONFIG.data.endpoint_configured) {
-      Serial.println("cannot send data - not configured");
-      return false;
+  // The FONA resolves the endpoint itself when opening the session.
+  step_result link_resolve() {
+    return STEP_DONE;
+  }
+
+  // The session is set up once and reused by later requests, until an
+  // error, an idle timeout, a change of endpoint or, for a raw socket, the
+  // end of the drain.
+  bool open_fona_session(char *url) {
+    #ifndef FONA_RAW_TCP
+      if (fona_session && rtc.now().unixtime() - fona_session_used > FONA_SESSION_IDLE_S) {
+        Serial.println("session idle, reopening");
+        close_fona_session();
+      }
+    #endif
+
+    if (fona_session && strcmp(url, fona_session_url) == 0) return true;
+
+    close_fona_session();
+
+    Serial.print("opening session to: "); Serial.println(url);
+
+    #ifdef FONA_RAW_TCP
+      if (!fona.TCPconnect(url, PORT)) return false;
+    #else
+      if (!fona.HTTP_POST_session_start(url, F("application/x-www-form-urlencoded"))) return false;
+    #endif
+
+    strcpy(fona_session_url, url);
+    fona_session = true;
+    return true;
+  }
+
+#ifdef FONA_RAW_TCP
+  // The whole request goes out in one AT+CIPSEND (split by the library past
+  // FONA_TCP_CHUNK_SIZE), instead of the SIM800 HTTP service's separate
+  // data upload and action.
+  step_result request_send(size_t length) {
+    check_fona_urcs();
+
+    if (!open_fona_session(CONFIG.data.endpoint_domain)) return STEP_FAILED;
+
+    int header_length = snprintf(fona_request, FONA_REQUEST_HEADER_SIZE,
+      "POST %s HTTP/1.1\r\n"
+      "Host: %s\r\n"
+      "User-Agent: %s\r\n"
+      "Content-Type: application/x-www-form-urlencoded\r\n"
+      "Content-Length: %u\r\n"
+      "\r\n",
+      CONFIG.data.endpoint_path, CONFIG.data.endpoint_domain, USER_AGENT_HEADER, (unsigned) length);
+
+    if (header_length >= FONA_REQUEST_HEADER_SIZE) return STEP_FAILED;
+    memcpy(fona_request + header_length, post_body, length);
+
+    Serial.print("posting data: "); Serial.println(post_body);
+
+    if (!fona.TCPsend(fona_request, header_length + length)) return STEP_FAILED;
+
+    http_response_begin(&fona_response);
+    return STEP_DONE;
+  }
+
+  // Each check for received bytes is an AT round trip, so whatever has
+  // arrived is read in one go.  The rest of the response is read as well,
+  // so the next one starts at its status line.
+  step_result request_await() {
+    uint16_t available = fona.TCPavailable();
+    if (available == 0) return STEP_PENDING;
+
+    while (available > 0 && fona_response.state < HTTP_RESPONSE_DONE) {
+      uint8_t buffer[64];
+      uint16_t read_size = fona.TCPread(buffer, min(available, (uint16_t) sizeof(buffer)));
+      if (read_size == 0) return STEP_FAILED;
+
+      available -= read_size;
+      http_response_feed(&fona_response, buffer, read_size);
     }
 
-    if (!gsmConnected) connect_to_fona();
-    watchdog_feed();
+    if (fona_response.state == HTTP_RESPONSE_ERROR) return STEP_FAILED;
+    if (fona_response.state != HTTP_RESPONSE_DONE) return STEP_PENDING;
 
-    int transmit_attempts = 1;
-    
-    while (!fona_post(temperature_f, humidity, heat_index, current_time)) {
-      Serial.print("failed to POST, trying again... attempt #");
-      Serial.println(transmit_attempts);
-      
-      if (transmit_attempts < 4) {
-        transmit_attempts++;
-        watchdog_feed();
-        delay(500);
-      } else {
-        while (true);
-      }
+    fona_status = fona_response.status;
+    if (fona_response.close) close_fona_session();
+
+    Serial.print("Status code: ");
+    Serial.println(fona_status);
+
+    return fona_status == 200 ? STEP_DONE : STEP_FAILED;
+  }
+#else
+  // HTTP_POST_session_send only returns once the FONA reports the action
+  // result, so the status is ready by the time it is awaited.  The response
+  // body is never read.
+  step_result request_send(size_t length) {
+    uint16_t response_length;
+
+    char url[200];
+    strcpy(url, CONFIG.data.endpoint_domain);
+    strcat(url, CONFIG.data.endpoint_path);
+
+    if (!open_fona_session(url)) return STEP_FAILED;
+
+    Serial.print("posting data: "); Serial.println(post_body);
+
+    if (!fona.HTTP_POST_session_send((uint8_t *) post_body, length, &fona_status, &response_length)) {
+      return STEP_FAILED;
     }
 
-    return true;
+    fona_session_used = rtc.now().unixtime();
+    return STEP_DONE;
   }
-#endif 
+
+  step_result request_await() {
+    if (fona_status != 200) {
+      Serial.print("status not 200: ");
+      Serial.println(fona_status);
+      return STEP_FAILED;
+    }
+
+    return STEP_DONE;
+  }
+#endif
+
+  // Servers drop an idle keep-alive socket within a minute or so, long
+  // before the next drain, so a raw socket is only reused within a drain.
+  void _end_transmit() {
+    #ifdef FONA_RAW_TCP
+      close_fona_session();
+    #endif
+  }
+#endif
 
 #ifdef HEATSEEK_FEATHER_WIFI_WICED
-  void force_wifi_reconnect(void) {
+  bool transmit_configured() {
+    return CONFIG.data.cell_configured && CONFIG.data.wifi_configured && CONFIG.data.endpoint_configured;
+  }
+
+  void link_reset() {
     wifiConnected = false;
   }
 
+  // a link that can't be brought up is started from scratch next time
+  void link_failed(transmit_state failed_state) {
+    if (failed_state == TRANSMIT_CONNECT) {
+      link_failures++;
+      link_reset();
+    }
+  }
+
   void receive_callback(void) {
     http.respParseHeader();
     int status_received = http.respStatus();
-    
+
     Serial.printf("transmitted - received status: (%d) \n", status_received);
-    
+
     http.stop();
     response_received = true;
     transmit_success = (status_received == 200);
   }
-  
+
   void connect_to_wifi() {
     Serial.print("Please wait while connecting to:");
     Serial.print(CONFIG.data.wifi_ssid);
     Serial.println("... ");
-  
+
+    // the SDK joins and runs DHCP in one call, so both count as association
+    uint32_t connect_started = millis();
+    link_attempts++;
+
     if (Feather.connect(CONFIG.data.wifi_ssid, CONFIG.data.wifi_pass)) {
+      latency_record(&association_latency, millis() - connect_started);
       Serial.println("Connected!");
       wifiConnected = true;
     } else {
       Serial.printf("Failed! %s (%d) \n", Feather.errstr());
     }
     Serial.println();
-  
+
     if (!Feather.connected()) { return; }
-  
+
     // Connected: Print network info
     Feather.printNetwork();
-    
-    // Tell the HTTP client to auto print error codes and halt on errors
-    http.err_actions(true, true);
-  
+
+    // Tell the HTTP client to auto print error codes, but return errors
+    // rather than halt so that the state machine can retry later
+    http.err_actions(true, false);
+
     // Set HTTP client verbose
     http.verbose(true);
-  
+
     // Set the callback handlers
     http.setReceivedCallback(receive_callback);
   }
-  
-  bool _transmit(float temperature_f, float humidity, float heat_index, uint32_t current_time) {
-    if (!CONFIG.data.cell_configured || !CONFIG.data.wifi_configured || !CONFIG.data.endpoint_configured) {
-      Serial.println("cannot send data - not configured");
-      return false;
-    }
-  
-    while (!wifiConnected) { connect_to_wifi(); }
-  
-    http.connect(CONFIG.data.endpoint_domain, PORT); // Will halt if an error occurs
-  
+
+  // The WICED SDK only offers a blocking join, bounded by its own timeout.
+  step_result link_connect() {
+    if (!wifiConnected) connect_to_wifi();
+    return wifiConnected ? STEP_DONE : STEP_FAILED;
+  }
+
+  // The WICED SDK resolves the endpoint as part of connecting.
+  step_result link_resolve() {
+    return STEP_DONE;
+  }
+
+  step_result request_send(size_t length) {
+    if (!http.connect(CONFIG.data.endpoint_domain, PORT)) return STEP_FAILED;
+
     http.addHeader("User-Agent", USER_AGENT_HEADER);
     http.addHeader("Connection", "close");
     http.addHeader("Content-Type", "application/x-www-form-urlencoded");
-  
-    char time_buffer[30];
-    char temperature_buffer[30];
-    char humidity_buffer[30];
-    char heat_index_buffer[30];
-    char reading_interval_buffer[30];
-  
-    sprintf(time_buffer, "%d", current_time);
-    sprintf(reading_interval_buffer, "%d", CONFIG.data.reading_interval_s);
-    sprintf(temperature_buffer, "%.3f", temperature_f);
-    sprintf(humidity_buffer, "%.3f", humidity);
-    sprintf(heat_index_buffer, "%.3f", heat_index);
-  
-    const char* post_data[][2] =
-    {
-      {"hub", CONFIG.data.hub_id},
-      {"cell", CONFIG.data.cell_id},
-      {"time", time_buffer},
-      {"temp", temperature_buffer},
-      {"humidity", humidity_buffer},
-      {"sp", reading_interval_buffer},
-      {"heat_index", heat_index_buffer},
-      {"cell_version", CODE_VERSION},
-    };
-    int param_count = 8;
-  
+
     response_received = false;
     transmit_success = false;
-  
-    http.post(CONFIG.data.endpoint_domain, CONFIG.data.endpoint_path, post_data, param_count); // Will halt if an error occurs
-  
-    while (!response_received || !transmit_success); // Hang if transmit doesn't complete or fails
 
-    return true;
+    if (!http.post(CONFIG.data.endpoint_domain, CONFIG.data.endpoint_path, post_body)) {
+      http.stop();
+      return STEP_FAILED;
+    }
+
+    return STEP_DONE;
+  }
+
+  // The status arrives through receive_callback.
+  step_result request_await() {
+    if (!response_received) return STEP_PENDING;
+    return transmit_success ? STEP_DONE : STEP_FAILED;
+  }
+
+  void _end_transmit() {
+    if (!response_received) http.stop();
   }
 #endif
 
 #ifdef HEATSEEK_FEATHER_WIFI_M0
-  void force_wifi_reconnect(void) {
-    if (wifiConnected) {
-      wifiConnected = false;
+  bool transmit_configured() {
+    return CONFIG.data.cell_configured && CONFIG.data.wifi_configured && CONFIG.data.endpoint_configured;
+  }
+
+  void close_http_connection() {
+    if (connection_request_count > 0) {
+      Serial.print("closing connection after ");
+      Serial.print(connection_request_count);
+      Serial.println(" request(s)");
+    }
+
+    http_client.stop();
+    connection_request_count = 0;
+    socket_connecting = false;
+  }
+
+  uint32_t rtc_seconds() {
+    return rtc.now().unixtime();
+  }
+
+  void link_reset() {
+    close_http_connection();
+
+    if (wifi_state != WIFI_DOWN) {
+      wifi_state = WIFI_DOWN;
       WiFi.end();
     }
   }
-  
-  void connect_to_wifi() {
-    WiFi.setPins(8, 7, 4, 2);
-    
-    Serial.print("Please wait while connecting to:");
-    Serial.print(CONFIG.data.wifi_ssid);
-    Serial.println("... ");
 
-    int status = WL_IDLE_STATUS;
+  // A server that stops accepting connections may have moved, so look it
+  // up again next time; the old address stays cached as a fallback.  If we
+  // joined with a cached lease, the lease may be the problem, so forget it.
+  void link_failed(transmit_state failed_state) {
+    bool unreachable = failed_state == TRANSMIT_RESOLVE || (failed_state == TRANSMIT_SEND && socket_connecting);
 
-    // Connect to WPA/WPA2 network. Change this line if using open or WEP network:
-    status = WiFi.begin(CONFIG.data.wifi_ssid, CONFIG.data.wifi_pass);
-    
-    while (status != WL_CONNECTED) {
-      delay(1000);
-      Serial.println("Establishing connection...");
+    if (unreachable) WiFi.flushDnsCache();
+
+    if (unreachable && wifi_fast) {
+      Serial.println("forgetting cached WiFi lease");
+      wifi_cache_clear();
+      link_reset();
     }
 
-    wifiConnected = true;
+    if (failed_state == TRANSMIT_CONNECT) {
+      link_failures++;
+      link_reset();
+    }
+  }
+
+  void print_wifi_status() {
     Serial.println("Connected to WiFi");
 
     Serial.print("SSID: ");
     Serial.println(WiFi.SSID());
-  
+
     // print the received signal strength:
     long rssi = WiFi.RSSI();
     Serial.print("signal strength (RSSI):");
     Serial.print(rssi);
     Serial.println(" dBm");
-
-    watchdog_feed();
   }
-  
-  bool _transmit(float temperature_f, float humidity, float heat_index, uint32_t current_time) {
-    if (!CONFIG.data.cell_configured || !CONFIG.data.wifi_configured || !CONFIG.data.endpoint_configured) {
-      Serial.println("cannot send data - not configured");
+
+  // Rejoin the cached access point with the cached lease as a static
+  // address, skipping DHCP.
+  bool begin_fast_connect() {
+    if (!wifi_cache_load(&wifi_ap, CONFIG.data.wifi_ssid)) return false;
+
+    if ((int32_t) (wifi_ap.data.lease_expires - rtc_seconds()) <= 0) {
+      Serial.println("cached DHCP lease expired");
       return false;
     }
-  
-    if (!wifiConnected) { connect_to_wifi(); }
 
-    HttpClient client = HttpClient(wifiClient, CONFIG.data.endpoint_domain, 80);
+    Serial.println("fast connect with cached lease");
+
+    WiFi.config(IPAddress(wifi_ap.data.local_ip), IPAddress(wifi_ap.data.dns), IPAddress(wifi_ap.data.gateway), IPAddress(wifi_ap.data.subnet));
+
+    return WiFi.begin(CONFIG.data.wifi_ssid, CONFIG.data.wifi_pass) != WL_CONNECT_FAILED;
+  }
+
+  bool begin_full_connect() {
+    memset(&wifi_ap, 0, sizeof(wifi_ap));
+    strncpy(wifi_ap.data.ssid, CONFIG.data.wifi_ssid, sizeof(wifi_ap.data.ssid) - 1);
 
-    String contentType = "application/x-www-form-urlencoded";
-    String data = "temp=" + String(temperature_f, 3) + "&humidity=" + String(humidity, 3) + "&heat_index=" + String(heat_index, 3) + "&hub=" + CONFIG.data.hub_id + "&cell=" + CONFIG.data.cell_id + "&time=" + current_time + "&sp=" + CONFIG.data.reading_interval_s + "&cell_version=" + CODE_VERSION;   
+    // Connect to WPA/WPA2 network. Change this line if using open or WEP network:
+    return WiFi.begin(CONFIG.data.wifi_ssid, CONFIG.data.wifi_pass) != WL_CONNECT_FAILED;
+  }
+
+  // Remember where we joined and the lease we got.  The lease is only
+  // reused for half its length, when a DHCP client would start renewing.
+  void cache_full_connect() {
+    uint32_t lease_time = WiFi.dhcpLeaseTime();
+
+    if (lease_time == 0) {
+      wifi_cache_clear();
+      return;
+    }
+
+    WiFi.BSSID(wifi_ap.data.bssid);
+    wifi_ap.data.local_ip = WiFi.localIP();
+    wifi_ap.data.gateway = WiFi.gatewayIP();
+    wifi_ap.data.subnet = WiFi.subnetMask();
+    wifi_ap.data.dns = WiFi.dnsIP();
+    wifi_ap.data.lease_expires = rtc_seconds() + lease_time / 2;
+    wifi_cache_save(&wifi_ap);
+  }
+
+  void check_fast_connect_bssid() {
+    uint8_t bssid[6];
+    WiFi.BSSID(bssid);
+
+    if (memcmp(bssid, wifi_ap.data.bssid, sizeof(bssid)) != 0) {
+      Serial.println("joined a different access point than last time");
+      memcpy(wifi_ap.data.bssid, bssid, sizeof(bssid));
+      wifi_cache_save(&wifi_ap);
+    }
+  }
+
+  void enter_wifi_state(wifi_link_state next_state) {
+    wifi_state = next_state;
+    wifi_state_started = millis();
+  }
+
+  // The cached fast path is tried first and the full join and DHCP is
+  // only used when there is no cache or the fast path fails.
+  step_result begin_wifi_connect() {
+    WiFi.setPins(8, 7, 4, 2);
+    WiFi.setTimeout(0);
+
+    Serial.print("Please wait while connecting to:");
+    Serial.print(CONFIG.data.wifi_ssid);
+    Serial.println("... ");
+
+    link_attempts++;
+    wifi_connect_started = millis();
+    wifi_fast = begin_fast_connect();
+
+    if (!wifi_fast && !begin_full_connect()) return STEP_FAILED;
+
+    enter_wifi_state(WIFI_ASSOCIATING);
+    return STEP_PENDING;
+  }
+
+  step_result wifi_connected() {
+    enter_wifi_state(WIFI_UP);
+
+    Serial.print(wifi_fast ? "fast" : "full");
+    Serial.print(" connect took ");
+    Serial.print(millis() - wifi_connect_started);
+    Serial.println(" ms");
+
+    if (wifi_fast) {
+      check_fast_connect_bssid();
+    } else {
+      cache_full_connect();
+    }
+
+    // let the WINC1500 doze between beacons while we're idle
+    WiFi.lowPowerMode();
+
+    print_wifi_status();
+    return STEP_DONE;
+  }
+
+  // A fast join already has its address, so it skips DHCP.
+  step_result poll_association() {
+    uint32_t elapsed = millis() - wifi_state_started;
+
+    if (WiFi.associated()) {
+      latency_record(&association_latency, elapsed);
+
+      if (wifi_fast) return wifi_connected();
+
+      enter_wifi_state(WIFI_DHCP);
+      return STEP_PENDING;
+    }
+
+    uint8_t status = WiFi.status();
+    bool refused = status == WL_DISCONNECTED || status == WL_CONNECT_FAILED;
+
+    if (!refused && elapsed < (wifi_fast ? FAST_CONNECT_TIMEOUT_MS : ASSOCIATE_TIMEOUT_MS)) return STEP_PENDING;
+
+    Serial.print(wifi_fast ? "fast join" : "join");
+    Serial.print(" failed after ");
+    Serial.print(elapsed);
+    Serial.println(" ms");
+
+    if (wifi_fast) {
+      Serial.println("falling back to full connect");
+      link_failures++;
+
+      // ending the connection also turns DHCP back on
+      wifi_cache_clear();
+      link_reset();
+      return STEP_PENDING;
+    }
+
+    return STEP_FAILED;
+  }
+
+  step_result poll_dhcp() {
+    uint32_t elapsed = millis() - wifi_state_started;
+
+    if (WiFi.status() == WL_CONNECTED) {
+      latency_record(&dhcp_latency, elapsed);
+      return wifi_connected();
+    }
+
+    if (!WiFi.associated()) {
+      Serial.println("lost access point during DHCP");
+      return STEP_FAILED;
+    }
+
+    if (elapsed < DHCP_TIMEOUT_MS) return STEP_PENDING;
+
+    Serial.print("no DHCP lease after ");
+    Serial.print(elapsed);
+    Serial.println(" ms");
+    return STEP_FAILED;
+  }
+
+  // The link goes DOWN -> ASSOCIATING -> DHCP -> UP, checking the WINC1500
+  // once per pass.  Association and DHCP each have their own deadline, so an
+  // access point that never answers fails the attempt instead of holding the
+  // radio on until the watchdog fires.
+  step_result link_connect() {
+    switch (wifi_state) {
+      case WIFI_DOWN:
+        return begin_wifi_connect();
+
+      case WIFI_ASSOCIATING:
+        return poll_association();
+
+      case WIFI_DHCP:
+        return poll_dhcp();
+
+      case WIFI_UP:
+        // a fast join runs on the cached lease with no DHCP client to
+        // renew it, so give the address up once the lease is due
+        if (wifi_fast && (int32_t) (wifi_ap.data.lease_expires - rtc_seconds()) <= 0) {
+          Serial.println("cached DHCP lease expired, rejoining");
+          link_reset();
+          return STEP_PENDING;
+        }
+
+        if (WiFi.status() == WL_CONNECTED) return STEP_DONE;
+
+        Serial.println("WiFi connection lost");
+        link_reset();
+        return STEP_PENDING;
+    }
+
+    return STEP_FAILED;
+  }
+
+  // WiFi101 caches the endpoint's address for dns_ttl_s, and falls back to
+  // the last address it resolved to if DNS doesn't answer.  Timing the
+  // cache by the RTC lets entries survive a warm reboot.
+  step_result link_resolve() {
+    if (!resolving) {
+      WiFi.setDnsCacheClock(rtc_seconds);
+      WiFi.setDnsCacheTtl(CONFIG.data.dns_ttl_s);
+
+      if (!WiFi.beginHostByName(CONFIG.data.endpoint_domain)) return STEP_FAILED;
+      resolving = true;
+    }
+
+    int result = WiFi.hostByNameResult(server_ip);
+    if (result == 0) return STEP_PENDING;
+
+    resolving = false;
+
+    Serial.print("DNS cache hits: "); Serial.print(WiFi.dnsCacheHits());
+    Serial.print(", misses: "); Serial.print(WiFi.dnsCacheMisses());
+    Serial.print(", fallbacks: "); Serial.println(WiFi.dnsCacheFallbacks());
+
+    return result > 0 ? STEP_DONE : STEP_FAILED;
+  }
+
+  // Opens the connection first if it is not already up, then sends the
+  // whole request.  The WINC1500 buffers the body, so sending doesn't wait
+  // on the server.
+  step_result request_send(size_t length) {
+    if (!wifiClient.connected()) {
+      if (!socket_connecting) {
+        // The server may have closed the connection since the last request.
+        if (connection_request_count > 0) {
+          Serial.print("server closed connection after ");
+          Serial.print(connection_request_count);
+          Serial.println(" request(s)");
+        }
+
+        close_http_connection();
+
+        if (!wifiClient.connectNoWait(server_ip, PORT)) return STEP_FAILED;
+        socket_connecting = true;
+      }
+
+      return STEP_PENDING;
+    }
+
+    socket_connecting = false;
+    http_client.connectionKeepAlive();
+    http_client.setHttpResponseTimeout(HTTP_CLIENT_TIMEOUT_MS);
+    http_client.setTimeout(HTTP_CLIENT_TIMEOUT_MS);
+
+    // The last response was read off the socket, not through HttpClient,
+    // which would otherwise still be waiting for it and refuse a new request.
+    http_client.beginRequest();
 
     Serial.print("Posting data: ");
-    Serial.println(data);
+    Serial.println(post_body);
+
+    if (http_client.post(CONFIG.data.endpoint_path, "application/x-www-form-urlencoded", post_body) != HTTP_SUCCESS) {
+      close_http_connection();
+      return STEP_FAILED;
+    }
 
-    client.post(CONFIG.data.endpoint_path, contentType, data);
+    http_response_begin(&wifi_response);
+    return STEP_DONE;
+  }
+
+  // HttpClient's response calls wait on every byte, so whatever has arrived
+  // is fed to the incremental parser instead and the rest is left for the
+  // next step.  The whole response is read, so the next one starts at its
+  // status line.
+  step_result request_await() {
+    int available = wifiClient.available();
+
+    if (available <= 0) {
+      if (!wifiClient.connected()) {
+        Serial.println("connection closed before response");
+        close_http_connection();
+        return STEP_FAILED;
+      }
+
+      return STEP_PENDING;
+    }
+
+    while (available > 0 && wifi_response.state < HTTP_RESPONSE_DONE) {
+      uint8_t buffer[64];
+      int read_size = wifiClient.read(buffer, min(available, (int) sizeof(buffer)));
+      if (read_size <= 0) break;
+
+      available -= read_size;
+      http_response_feed(&wifi_response, buffer, read_size);
+    }
+
+    if (wifi_response.state == HTTP_RESPONSE_ERROR) {
+      // the connection is in an unknown state; start the next request fresh
+      close_http_connection();
+      return STEP_FAILED;
+    }
+    if (wifi_response.state != HTTP_RESPONSE_DONE) return STEP_PENDING;
 
-    int statusCode = client.responseStatusCode();
-    String response = client.responseBody();
-  
     Serial.print("Status code: ");
-    Serial.println(statusCode);
-    Serial.print("Response: ");
-    Serial.println(response);
-  
-    return statusCode == 200;
+    Serial.println(wifi_response.status);
+
+    connection_request_count++;
+    if (wifi_response.close) close_http_connection();
+
+    return wifi_response.status == 200 ? STEP_DONE : STEP_FAILED;
+  }
+
+  void _end_transmit() {
+    resolving = false;
+    close_http_connection();
   }
 #endif
 
+static transmit_state state = TRANSMIT_IDLE;
+static uint32_t state_started = 0;
+static packed_reading batch[BATCH_MAX_SIZE];
+static int batch_count = 0;
+static size_t batch_length = 0;
+static int backlog_requests = 0;
+static uint32_t backlog_bytes = 0;
+static uint32_t request_started = 0;
+static uint32_t request_longest_step_ms = 0;
+
+// How long a request takes from building its body to being acknowledged,
+// and the longest single step within one, which must stay well inside the
+// watchdog period since the watchdog is only fed between steps.
+static latency_estimate request_latency;
+static latency_estimate step_latency;
+static uint32_t drain_started = 0;
+static uint32_t last_drain_ms = 0;
+static uint8_t failed_drains = 0;
+
+#define LIVE_READING_MAGIC 0x4c495645 // "LIVE"
+#define LIVE_READINGS_MAX  2
+
+// Uploads run in two lanes.  New readings go in the live lane, are sent
+// straight from RAM newest first, and are only written to the queue if
+// sending them fails.  The backlog lane sends the summaries and queued
+// readings oldest first, within its own budget per drain.
+//
+// Live readings are always newer than anything queued, and are queued
+// oldest first, so the queue stays in timestamp order.  Two slots let a
+// reading that arrives while the last one is in flight go out next
+// without queueing.  They are kept in retained RAM, so a watchdog reset
+// part way through a send queues them at the next startup.  Boards
+// without retained RAM queue every reading up front instead.
 typedef struct {
-  float temperature_f;
-  float humidity;
-  float heat_index;
-} temp_data_struct;
-
-typedef union {
-  temp_data_struct data;
-  uint8_t raw[sizeof(temp_data_struct)];
-} temp_data;
-
-// Create a file on the SD card representing a temperature reading
-// The file name is the unix timestamp, however, due to FAT naming conventions,
-// we have to place a period in it.   e.g.   1500985299   ->  1500985.299
-// The content of the file is the binary reading data struct.
-void queue_transmission(char *filename, temp_data temp, uint32_t current_time) {
-  char file_path[50];
-  char timestamp[50];
-  char timestamp_first_half[50];
-  char timestamp_last_half[50];
-
-  // FAT only allows 8 character names, so we make the last 3 digits of the 
-  // timestamp the file "extension"
-  sprintf(timestamp, "%d", current_time);
-  strncpy(timestamp_first_half, timestamp, 7);
-  timestamp_first_half[7] = '\0';
-  strncpy(timestamp_last_half, timestamp+7, 3);
-  timestamp_last_half[3] = '\0';
-
-  sprintf(filename, "%s.%s", timestamp_first_half, timestamp_last_half);
-  sprintf(file_path, "pending/%s", filename);
-
-  File temperature_file;
-  SD.mkdir("pending");
-  if (temperature_file = SD.open(file_path, FILE_WRITE | O_TRUNC)) {
-    temperature_file.write(temp.raw, sizeof(temp));
-    temperature_file.close();
+  uint32_t magic;
+  uint8_t count;
+  packed_reading readings[LIVE_READINGS_MAX];  // oldest first
+  uint32_t checksum;
+} live_reading_struct;
+
+static live_reading_struct live_reading RETAINED;
+
+// What the batch being sent was taken from, in the order they are sent.
+typedef enum {
+  BATCH_LIVE,
+  BATCH_SUMMARIES,
+  BATCH_QUEUED
+} batch_source;
+
+static batch_source batch_from = BATCH_QUEUED;
+static uint32_t batch_queue_removed = 0;  // queue_removed() when the batch was peeked
+static summary_reading summary_batch[SUMMARY_BATCH_SIZE];
+
+static uint32_t live_reading_checksum() {
+  return retained_checksum(&live_reading, offsetof(live_reading_struct, checksum));
+}
+
+static bool live_reading_pending() {
+  return live_reading.magic == LIVE_READING_MAGIC &&
+         live_reading.checksum == live_reading_checksum() &&
+         live_reading.count > 0 && live_reading.count <= LIVE_READINGS_MAX;
+}
+
+static void save_live_readings() {
+  live_reading.magic = LIVE_READING_MAGIC;
+  live_reading.checksum = live_reading_checksum();
+}
+
+// Remove the live reading taken at time, once it has been sent.
+static void remove_live_reading(uint32_t time) {
+  if (!live_reading_pending()) return;
+
+  for (uint8_t i = 0; i < live_reading.count; i++) {
+    if (live_reading.readings[i].data.time != time) continue;
+
+    for (; i + 1 < live_reading.count; i++) live_reading.readings[i] = live_reading.readings[i + 1];
+    live_reading.count--;
+    save_live_readings();
+    return;
+  }
+}
+
+// Queue the oldest live reading.
+static void spill_oldest_live_reading() {
+  Serial.print("queueing unsent reading: ");
+  Serial.println(live_reading.readings[0].data.time);
+
+  queue_push(&live_reading.readings[0]);
+  remove_live_reading(live_reading.readings[0].data.time);
+}
+
+static void spill_live_reading() {
+  while (live_reading_pending()) spill_oldest_live_reading();
+}
+
+// A reading queued while the batch was in flight can push the oldest
+// segment out of a full queue, taking the front of the batch with it, so
+// only pop what is still there.
+static void pop_queued_batch() {
+  uint32_t dropped = queue_removed() - batch_queue_removed;
+  if (dropped < (uint32_t) batch_count) queue_pop(batch_count - dropped);
+}
+
+static void enter_state(transmit_state next_state) {
+  state = next_state;
+  state_started = millis();
+}
+
+static uint32_t state_timeout_ms() {
+  switch (state) {
+    case TRANSMIT_CONNECT:       return LINK_TIMEOUT_MS;
+    case TRANSMIT_RESOLVE:       return RESOLVE_TIMEOUT_MS;
+    case TRANSMIT_SEND:          return SEND_TIMEOUT_MS;
+    case TRANSMIT_AWAIT_STATUS:  return RESPONSE_TIMEOUT_MS;
+    default:                     return 0;
+  }
+}
+
+// Take the live reading if there is one, then any hourly summaries, then
+// the oldest queued readings, and build the body for them.
+static step_result prepare_batch() {
+  int batch_size = constrain(CONFIG.data.batch_size, 1, BATCH_MAX_SIZE);
+
+  if (live_reading_pending()) {
+    batch_from = BATCH_LIVE;
+    batch[0] = live_reading.readings[live_reading.count - 1];
+    batch_count = 1;
+  } else if (summary_depth() > 0) {
+    batch_from = BATCH_SUMMARIES;
+    batch_count = summary_peek(summary_batch, SUMMARY_BATCH_SIZE);
   } else {
-    Serial.println("unable to write temperature");
-    while(true); // watchdog will reboot
+    batch_from = BATCH_QUEUED;
+    batch_count = queue_peek(batch, batch_size);
+    batch_queue_removed = queue_removed();
+  }
+
+  if (batch_count == 0) {
+    Serial.println("failed to read queued readings");
+    return STEP_FAILED;
   }
+
+  if (batch_from == BATCH_SUMMARIES) {
+    batch_length = format_summary_body(post_body, sizeof(post_body), summary_batch, batch_count);
+  } else {
+    batch_length = format_post_body(post_body, sizeof(post_body), batch, batch_count);
+  }
+  if (batch_length == 0) return STEP_FAILED;
+
+  Serial.print("transfering "); Serial.print(batch_count);
+  Serial.print(batch_from == BATCH_SUMMARIES ? " summaries from: " : " reading(s) from: ");
+  Serial.println(batch_from == BATCH_SUMMARIES ? summary_batch[0].data.time : batch[0].data.time);
+
+  return STEP_DONE;
 }
 
-// Take a filename for a reading, read the temperature data and
-// transmit it.  Then delete the file when the transfer is successful.
-void transmit_queued_temp(char *filename) {
+static bool radio_cap_reached() {
+  return millis() - drain_started >= RADIO_ON_CAP_MS;
+}
+
+static void finish_drain() {
+  _end_transmit();
+
+  batch_count = 0;
+  last_drain_ms = millis() - drain_started;
+  enter_state(TRANSMIT_IDLE);
+
+  Serial.print("backlog requests: ");
+  Serial.print(backlog_requests);
+  Serial.print(", request estimate (ms): ");
+  Serial.print(request_latency.average_ms);
+  Serial.print(", longest step estimate (ms): ");
+  Serial.println(latency_estimate_upper(&step_latency));
+
+  Serial.print("queued readings remaining: ");
+  Serial.print(queue_depth());
+  Serial.print(", summaries: ");
+  Serial.println(summary_depth());
+  heap_report();
+}
+
+// Start sending the live reading and draining the queue, unless a drain
+// is already running.
+void transmit_start() {
+  if (state != TRANSMIT_IDLE || (!transmit_pending() && !live_reading_pending())) return;
+
+  backlog_requests = 0;
+  backlog_bytes = 0;
+  batch_count = 0;
+  drain_started = millis();
+  enter_state(TRANSMIT_CONNECT);
+}
+
+// Whether anything is waiting in the queue or the summaries.
+bool transmit_pending() {
+  return queue_depth() > 0 || summary_depth() > 0;
+}
+
+// A drain aims to keep the radio busy for DRAIN_TARGET_PERCENT of the
+// reading interval, never more than RADIO_ON_CAP_MS.
+static uint32_t drain_budget_ms() {
+  uint32_t target_ms = (uint32_t) CONFIG.data.reading_interval_s * 10 * DRAIN_TARGET_PERCENT;
+  return min(target_ms, (uint32_t) RADIO_ON_CAP_MS);
+}
+
+// Another backlog request is sent only if the estimate says it will finish
+// inside the drain budget and its steps won't come close to the watchdog.
+static bool backlog_budget_left() {
+  return transmit_pending() &&
+         backlog_bytes < BACKLOG_BYTES_PER_DRAIN &&
+         millis() - drain_started + latency_estimate_upper(&request_latency) < drain_budget_ms() &&
+         latency_estimate_upper(&step_latency) < WATCHDOG_PERIOD_MS / 100 * WATCHDOG_SAFE_PERCENT;
+}
+
+bool transmit_busy() {
+  return state != TRANSMIT_IDLE;
+}
+
+static drain_status step_drain() {
+  step_result result = STEP_DONE;
+
   watchdog_feed();
-  
-  File temperature_file;
-  temp_data temperature;
-  char read_time_buffer[100];
-  char file_path[100];
-  sprintf(file_path, "pending/%s", filename);
-  
-  Serial.print("transfering: ");
-  Serial.println(filename);
-
-  strncpy(read_time_buffer, filename, 7);
-  strncpy(read_time_buffer+7, filename+8, 3);
-  read_time_buffer[10] = '\0';
-
-  uint32_t read_time = strtoul(read_time_buffer, NULL, 0);
-
-  if (temperature_file = SD.open(file_path, FILE_READ)) {
-    int read_size = temperature_file.read(temperature.raw, sizeof(temperature));
-    
-    if (sizeof(temperature) == read_size) {
-      bool transmit_success = _transmit(temperature.data.temperature_f, temperature.data.humidity, temperature.data.heat_index, read_time);
-      
-      temperature_file.close();
-      delay(100);
-        
-      if (transmit_success) {
-        Serial.println("transferred.");
-
-        if (SD.remove(file_path)) {
-          Serial.println("removed.");
-        } else {
-          Serial.println("failed to remove file");
-        }
+
+  switch (state) {
+    case TRANSMIT_IDLE:
+      return DRAIN_FINISHED;
+
+    case TRANSMIT_CONNECT:
+      if (!transmit_configured()) {
+        Serial.println("cannot send data - not configured");
+        result = STEP_FAILED;
+        break;
+      }
+
+      result = link_connect();
+      if (result == STEP_DONE) enter_state(TRANSMIT_RESOLVE);
+      break;
+
+    case TRANSMIT_RESOLVE:
+      result = link_resolve();
+      if (result == STEP_DONE) enter_state(TRANSMIT_SEND);
+      break;
+
+    case TRANSMIT_SEND:
+      if (batch_count == 0) {
+        request_started = millis();
+        request_longest_step_ms = 0;
+        result = prepare_batch();
+      }
+      if (result == STEP_DONE) result = request_send(batch_length);
+      if (result == STEP_DONE) enter_state(TRANSMIT_AWAIT_STATUS);
+      break;
+
+    case TRANSMIT_AWAIT_STATUS:
+      result = request_await();
+      if (result == STEP_DONE) enter_state(TRANSMIT_DEQUEUE);
+      break;
+
+    case TRANSMIT_DEQUEUE:
+      Serial.println("transferred.");
+      latency_estimate_update(&request_latency, millis() - request_started);
+      latency_estimate_update(&step_latency, request_longest_step_ms);
+      switch (batch_from) {
+        case BATCH_LIVE:       remove_live_reading(batch[0].data.time); break;
+        case BATCH_SUMMARIES:  summary_pop(batch_count); break;
+        case BATCH_QUEUED:     pop_queued_batch(); break;
+      }
+      if (batch_from != BATCH_LIVE) {
+        backlog_requests++;
+        backlog_bytes += batch_length;
+      }
+      batch_count = 0;
+
+      if (!radio_cap_reached() && (live_reading_pending() || backlog_budget_left())) {
+        enter_state(TRANSMIT_SEND);
       } else {
-        Serial.println("failed to transfer");
+        failed_drains = 0;
+        finish_drain();
+        return DRAIN_FINISHED;
       }
-    } else {
-      Serial.print("file incorrect size - expected: ");
-      Serial.print(sizeof(temperature));
-      Serial.print(", got: ");
-      Serial.println(read_size);
-    }
-  } else {
-    Serial.print("failed to open: ");
-    Serial.println(filename);
+      break;
   }
-    
-  watchdog_feed();
-}
 
-void transmit_queued_temps() {
-  char filename[100];
-  File pending_dir = SD.open("pending");
-  int temps_transfered_count = 0;
+  if (result == STEP_PENDING && millis() - state_started > state_timeout_ms()) {
+    Serial.println("timed out");
+    result = STEP_FAILED;
+  }
 
-  while (temps_transfered_count < TRANSMITS_PER_LOOP) {
-    File entry = pending_dir.openNextFile();
-    if (!entry) { break; } // No more files
-    
-    strcpy(filename, entry.name());
-    entry.close();
-    
-    transmit_queued_temp(filename);
-    temps_transfered_count += 1;
+  bool cap_reached = result == STEP_PENDING && radio_cap_reached();
+  if (cap_reached) {
+    Serial.println("radio on too long this cycle");
+    result = STEP_FAILED;
   }
 
-  pending_dir.close();
+  if (result == STEP_FAILED) {
+    Serial.println("failed to transfer");
+
+    link_failed(state);
+    if (cap_reached) link_reset();
+
+    if (failed_drains < 255) failed_drains++;
+
+    spill_live_reading();
+    finish_drain();
+    return DRAIN_FAILED;
+  }
+
+  return DRAIN_RUNNING;
 }
 
-void clear_queued_transmissions() {
-  File pending_dir = SD.open("pending");
+// Advance the current drain by one step.  A drain sends the live readings,
+// then backlog for as long as backlog_budget_left() allows, and stops at
+// the first failure.
+drain_status transmit_step() {
+  uint32_t started = millis();
+  drain_status status = step_drain();
 
-  Serial.println("==== Removing queued temperature files");
-  while (true) {
-    watchdog_feed();
-    
-    File entry = pending_dir.openNextFile();
-    if (!entry) { break; } // No more files
-
-    char filename[100];
-    strcpy(filename, entry.name());
-    entry.close();
-
-    char file_path[100];
-    sprintf(file_path, "pending/%s", filename);
-  
-    if (SD.remove(file_path)) {
-      Serial.println("removed queued temperature file.");
-    } else {
-      Serial.println("failed to remove queued temperature file.");
-    }
+  request_longest_step_ms = max(request_longest_step_ms, (uint32_t) (millis() - started));
+  return status;
+}
+
+// How long to wait before draining again after a failed drain.  The wait
+// doubles with each failure in a row, so an access point or cell network
+// that is down costs a few short attempts rather than one per minute.
+uint32_t transmit_retry_delay_s() {
+  uint32_t delay_s = DRAIN_RETRY_INTERVAL_S;
+
+  for (uint8_t i = 1; i < failed_drains && delay_s < DRAIN_RETRY_MAX_INTERVAL_S; i++) {
+    delay_s *= 2;
   }
-  
+
+  return min(delay_s, (uint32_t) DRAIN_RETRY_MAX_INTERVAL_S);
+}
+
+// Drop any drain in progress without touching the queue.
+static void transmit_abort() {
+  if (state == TRANSMIT_IDLE) return;
+
+  Serial.println("aborting transfer");
+  spill_live_reading();
+  _end_transmit();
+  batch_count = 0;
+  enter_state(TRANSMIT_IDLE);
+}
+
+#ifdef TRANSMITTER_WIFI
+void force_wifi_reconnect() {
+  transmit_abort();
+  link_reset();
+}
+
+void print_link_stats() {
+  Serial.print("WiFi connect attempts: ");
+  Serial.print(link_attempts);
+  Serial.print(", failures: ");
+  Serial.println(link_failures);
+
+  latency_print("association", &association_latency);
+  #ifdef HEATSEEK_FEATHER_WIFI_M0
+    latency_print("DHCP", &dhcp_latency);
+  #endif
+
+  Serial.print("last drain (ms): ");
+  Serial.print(last_drain_ms);
+  Serial.print(", failed drains in a row: ");
+  Serial.println(failed_drains);
+}
+#endif
+
+void clear_queued_transmissions() {
+  Serial.println("==== Removing queued temperature readings");
+  transmit_abort();
+  queue_clear();
+  summary_clear();
   Serial.println("====");
+}
 
-  pending_dir.close();
+// Queue a live reading left over from before a watchdog reset.
+void transmit_initialize() {
+  if (RETAINED_RAM) spill_live_reading();
 }
 
-void transmit(float temperature_f, float humidity, float heat_index, uint32_t current_time) {
+void transmit(packed_reading *reading) {
   watchdog_feed();
-  
-  temp_data temp;
-  temp.data.temperature_f = temperature_f;
-  temp.data.humidity = humidity;
-  temp.data.heat_index = heat_index;
-
-  char filename[100];
-  queue_transmission(filename, temp, current_time);
-  watchdog_feed();
-  delay(1000);
-    
-  Serial.print("created file: ");
-  Serial.println(filename);
 
-  transmit_queued_temp(filename);
-  transmit_queued_temps();
+  if (RETAINED_RAM) {
+    if (!live_reading_pending()) {
+      live_reading.count = 0;
+    } else if (live_reading.count == LIVE_READINGS_MAX) {
+      spill_oldest_live_reading();
+    }
+
+    live_reading.readings[live_reading.count++] = *reading;
+    save_live_readings();
+  } else {
+    queue_push(reading);
+    watchdog_feed();
+
+    Serial.print("queued reading: ");
+    Serial.println(reading->data.time);
+  }
+
+  transmit_start();
 }
@@ -4,6 +4,7 @@
 #define CODE_VERSION "F-1.2.0"
 
 #include "user_config.h"
+#include "reading.h"
 
 #ifdef HEATSEEK_FEATHER_CELL_M0
   #define TRANSMITTER_GSM
@@ -19,7 +20,8 @@
   #define DHT_DATA  PC2
   #define SD_CS     PB4
   
-  #define TRANSMITS_PER_LOOP 20
+  #define DRAIN_TARGET_PERCENT  25  // of the reading interval
+  #define BACKLOG_BYTES_PER_DRAIN  (32UL * 1024)
 #endif
 
 #ifdef HEATSEEK_FEATHER_WIFI_M0
@@ -28,8 +30,10 @@
 
   #define DHT_DATA  A2
   #define SD_CS     10
+  // #define RTC_INT_PIN  5  // only if the Adalogger's INT pad is wired to a pin
   
-  #define TRANSMITS_PER_LOOP 20
+  #define DRAIN_TARGET_PERCENT  25  // of the reading interval
+  #define BACKLOG_BYTES_PER_DRAIN  (32UL * 1024)
 #endif
 
 #ifdef TRANSMITTER_GSM
@@ -39,20 +43,61 @@
   #define DHT_DATA  A2
   #define SD_CS     10
   #define FONA_RST  A4
+  #define FONA_BAUD_CHECKS  5  // AT round trips that must all come back clean
+
+  // Post over one kept-alive TCP socket per drain instead of the SIM800
+  // HTTP service
+  // #define FONA_RAW_TCP
+
+  #ifdef FONA_RAW_TCP
+    #define FONA_REQUEST_HEADER_SIZE  384
+  #else
+    #define FONA_SESSION_IDLE_S  (15UL * 60)  // HTTP session left open between drains
+  #endif
   #define LORA_CS   8
+  // #define RTC_INT_PIN  5  // only if the Adalogger's INT pad is wired to a pin
   
-  #define TRANSMITS_PER_LOOP 5
+  #define DRAIN_TARGET_PERCENT  10  // of the reading interval
+  #define BACKLOG_BYTES_PER_DRAIN  (4UL * 1024)  // metered data
 #endif
 
 #define SEND_SAVED_READINGS_THRESHOLD (10 * 60)
+#define BATCH_MAX_SIZE     20
 #define USER_AGENT_HEADER  "curl/7.45.0"
 #define PORT               80
+#define DEFAULT_DNS_TTL_S  (60 * 60)
+
+// Deadlines for each upload state, in milliseconds.  States are polled a
+// step at a time with the watchdog fed in between, so these may run past
+// the watchdog period; a call that blocks within one step may not.
+#define LINK_TIMEOUT_MS      60000  // WiFi association or GPRS attach
+#define FAST_CONNECT_TIMEOUT_MS  5000  // cached access point and lease, before a full connect
+#define ASSOCIATE_TIMEOUT_MS 20000  // joining the access point, per attempt
+#define DHCP_TIMEOUT_MS      15000  // getting a lease once joined
+#define RESOLVE_TIMEOUT_MS   25000  // WiFi101 falls back to the cached address after 20 s
+#define SEND_TIMEOUT_MS      20000  // includes opening the connection
+#define HTTP_CLIENT_TIMEOUT_MS  5000  // any one HttpClient call on the WiFi M0
+#define RESPONSE_TIMEOUT_MS  30000  // polled until the whole response is read
+#define RADIO_ON_CAP_MS      180000  // a whole drain, across all of its steps
+#define WATCHDOG_SAFE_PERCENT  60   // longest expected step, as a share of the watchdog period
+
+typedef enum {
+  DRAIN_RUNNING,
+  DRAIN_FINISHED,
+  DRAIN_FAILED
+} drain_status;
 
-void transmit(float temperature_f, float humidity, float heat_index, uint32_t current_time);
-void transmit_queued_temps();
+void transmit_initialize();
+void transmit(packed_reading *reading);
+void transmit_start();
+bool transmit_pending();
+bool transmit_busy();
+drain_status transmit_step();
+uint32_t transmit_retry_delay_s();
 void clear_queued_transmissions();
 #ifdef TRANSMITTER_WIFI
 void force_wifi_reconnect();
+void print_link_stats();
 #endif
   
 #endif
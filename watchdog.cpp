@@ -10,7 +10,7 @@ void watchdog_init() {
   #endif
 
   #if defined(HEATSEEK_FEATHER_WIFI_M0) || defined(TRANSMITTER_GSM)
-    Watchdog.enable(16000);  // 16 seconds (this is the max supported)
+    Watchdog.enable(WATCHDOG_PERIOD_MS);
   #endif
 }
 
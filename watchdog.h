@@ -3,6 +3,12 @@
 
 #include "transmit.h"
 
+#ifdef HEATSEEK_FEATHER_WIFI_WICED
+  #define WATCHDOG_PERIOD_MS  20000  // nominally 22 s, less if the LSI runs fast
+#else
+  #define WATCHDOG_PERIOD_MS  16000  // the most the SAMD21 supports
+#endif
+
 void watchdog_init();
 void watchdog_feed();
 
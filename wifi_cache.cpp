@@ -0,0 +1,61 @@
+#include <stddef.h>
+#include <SD.h>
+#include "wifi_cache.h"
+#include "retained.h"
+
+#define WIFI_CACHE_MAGIC 0x57494649 // "WIFI"
+
+// The last access point and DHCP lease are kept in retained RAM, which
+// covers watchdog reboots, and in wifi.bin for power cycles.  Both copies
+// are only written when a full connect learns something new.
+static wifi_cache retained_wifi_cache RETAINED;
+
+static uint32_t cache_checksum(wifi_cache *cache) {
+  return retained_checksum(cache->raw, offsetof(wifi_cache_struct, checksum));
+}
+
+static bool cache_valid(wifi_cache *cache, const char *ssid) {
+  return cache->data.magic == WIFI_CACHE_MAGIC &&
+         cache->data.checksum == cache_checksum(cache) &&
+         strncmp(cache->data.ssid, ssid, sizeof(cache->data.ssid)) == 0;
+}
+
+// Returns true if there is a cached access point for ssid.
+bool wifi_cache_load(wifi_cache *cache, const char *ssid) {
+  if (RETAINED_RAM && cache_valid(&retained_wifi_cache, ssid)) {
+    *cache = retained_wifi_cache;
+    return true;
+  }
+
+  File cache_file;
+
+  if (!(cache_file = SD.open("wifi.bin", FILE_READ))) return false;
+
+  int read_size = cache_file.read(cache->raw, sizeof(*cache));
+  cache_file.close();
+
+  if (read_size != sizeof(*cache) || !cache_valid(cache, ssid)) return false;
+
+  retained_wifi_cache = *cache;
+  return true;
+}
+
+void wifi_cache_save(wifi_cache *cache) {
+  cache->data.magic = WIFI_CACHE_MAGIC;
+  cache->data.checksum = cache_checksum(cache);
+  retained_wifi_cache = *cache;
+
+  File cache_file;
+
+  if (cache_file = SD.open("wifi.bin", FILE_WRITE | O_TRUNC)) {
+    cache_file.write(cache->raw, sizeof(*cache));
+    cache_file.close();
+  } else {
+    Serial.println("unable to save wifi cache");
+  }
+}
+
+void wifi_cache_clear() {
+  memset(&retained_wifi_cache, 0, sizeof(retained_wifi_cache));
+  SD.remove("wifi.bin");
+}
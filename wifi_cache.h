@@ -0,0 +1,28 @@
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <Arduino.h>
+
+// What we need to rejoin the last access point without DHCP.
+typedef struct {
+  uint32_t magic;
+  char ssid[50];
+  uint8_t bssid[6];
+  uint32_t local_ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t lease_expires;  // unix time
+  uint32_t checksum;
+} wifi_cache_struct;
+
+typedef union {
+  wifi_cache_struct data;
+  uint8_t raw[sizeof(wifi_cache_struct)];
+} wifi_cache;
+
+bool wifi_cache_load(wifi_cache *cache, const char *ssid);
+void wifi_cache_save(wifi_cache *cache);
+void wifi_cache_clear();
+
+#endif